@@ -0,0 +1,486 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+// Bus cost benchmark of the PCA9622 driver on the simulated bus (see
+// extras/host). Each workload runs against a fresh device model and
+// reports transfers, bytes and simulated bus time. Results are written as
+// CSV and compared against a baseline; the run fails if any workload got
+// more expensive
+//
+// Usage: benchmark [results.csv] [baseline.csv] [--update]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PCA9622.h"
+#include "PCA9622Blinker.h"
+#include "PCA9622Model.h"
+#include "PCA9622Program.h"
+#include "PCA9622Verifier.h"
+#include "PCA9622View.h"
+
+#define DEVICE_ADDRESS 0x18
+#define BUS_CLOCK      400000
+#define MAX_WORKLOADS  32
+
+struct Result {
+  char name[32];
+  uint32_t ops;
+  uint32_t transfers;
+  uint32_t bytes;
+  uint64_t busTimeNs;
+  uint32_t latches;
+};
+
+static Result results[MAX_WORKLOADS];
+static uint8_t numResults = 0;
+
+// Model of the running workload, for fault injection, and failed checks
+static PCA9622Model *currentModel = NULL;
+static uint32_t checkFailures = 0;
+
+#define CHECK(condition) \
+  if (!(condition)) { \
+    fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+    checkFailures++; \
+  }
+
+typedef uint32_t (*Workload)(PCA9622 &pca9622);
+
+/******************************** WORKLOADS ***********************************/
+
+// Five RGB fixtures on one device, one frame
+static uint32_t rgbFrame(PCA9622 &pca9622) {
+
+  for (uint8_t i = 0; i < 5; i++) {
+    pca9622.setPwm(REG_PWM0 + 3 * i, 10 * i);
+    pca9622.setPwm(REG_PWM1 + 3 * i, 20 * i);
+    pca9622.setPwm(REG_PWM2 + 3 * i, 30 * i);
+  }
+
+  return 1;
+}
+
+static uint32_t rgbFrameDeferred(PCA9622 &pca9622) {
+
+  pca9622.setDeferred(true);
+  rgbFrame(pca9622);
+  pca9622.flush();
+  pca9622.setDeferred(false);
+
+  return 1;
+}
+
+static uint32_t rgbFrameCommit(PCA9622 &pca9622) {
+
+  pca9622.beginFrame();
+  rgbFrame(pca9622);
+  pca9622.commitFrame();
+
+  return 1;
+}
+
+// Five RGB fixture views on one device, one frame
+static uint32_t fixtureViews(PCA9622 &pca9622) {
+
+  for (uint8_t i = 0; i < 5; i++) {
+    PCA9622RGBView fixture(&pca9622, REG_PWM0 + 3 * i, REG_PWM1 + 3 * i, REG_PWM2 + 3 * i);
+    fixture.setRGB(10 * i, 20 * i, 30 * i);
+  }
+
+  pca9622.commit();
+
+  return 1;
+}
+
+// Deferred flush while the device does not acknowledge, then again once it is back
+static uint32_t flushFailure(PCA9622 &pca9622) {
+
+  pca9622.setDeferred(true);
+  pca9622.setPwm(REG_PWM0, 10);
+  pca9622.setPwm(REG_PWM5, 50);
+
+  currentModel->setConnected(false);
+  pca9622.flush();
+  CHECK(pca9622.getLastError() != PCA9622_OK);
+
+  currentModel->setConnected(true);
+  pca9622.flush();
+  CHECK(pca9622.getLastError() == PCA9622_OK);
+  CHECK(currentModel->reg(REG_PWM0) == 10 && currentModel->reg(REG_PWM5) == 50);
+
+  pca9622.setDeferred(false);
+
+  return 2;
+}
+
+static uint32_t allPwmFrame(PCA9622 &pca9622) {
+
+  uint8_t pwm[16];
+
+  for (uint8_t i = 0; i < 16; i++) {
+    pwm[i] = 16 * i;
+  }
+
+  pca9622.setAllPwm(pwm);
+
+  return 1;
+}
+
+// 16 channels fading from 0 to 255 in 16 steps, one channel at a time
+static uint32_t channelFades(PCA9622 &pca9622) {
+
+  for (uint16_t step = 0; step < 16; step++) {
+    for (uint8_t channel = 0; channel < 16; channel++) {
+      pca9622.setPwm(REG_PWM0 + channel, step * 17);
+    }
+  }
+
+  return 16;
+}
+
+static uint32_t turnOffOn(PCA9622 &pca9622) {
+
+  pca9622.turnOff();
+  pca9622.turnOn();
+
+  return 1;
+}
+
+// Set up two scenes that differ in a few channels, then switch four times
+static uint32_t sceneSwitch(PCA9622 &pca9622) {
+
+  PCA9622Scene scenes[2];
+
+  pca9622.setDeferred(true);
+  pca9622.setLdrStateAll(LDR_STATE_IND);
+
+  for (uint8_t channel = 0; channel < 16; channel++) {
+    pca9622.setPwm(REG_PWM0 + channel, 0x40);
+  }
+
+  pca9622.saveScene(scenes[0]);
+  pca9622.setPwm(REG_PWM3, 0xFF);
+  pca9622.setPwm(REG_PWM4, 0xFF);
+  pca9622.setPwm(REG_PWM12, 0x00);
+  pca9622.saveScene(scenes[1]);
+  pca9622.setDeferred(false);
+
+  for (uint8_t i = 0; i < 4; i++) {
+    pca9622.applyScene(scenes[i % 2]);
+  }
+
+  return 4;
+}
+
+// Read the whole register file, then write it back
+static uint32_t snapshotRestore(PCA9622 &pca9622) {
+
+  PCA9622Snapshot snapshot;
+
+  pca9622.snapshot(snapshot);
+  pca9622.restore(snapshot);
+
+  return 1;
+}
+
+// Mode change: group blinking on all channels with a base color
+static uint32_t modeSequence(PCA9622 &pca9622) {
+
+  pca9622.setLdrStateAll(LDR_STATE_IND_GRP);
+  pca9622.setGroupControlMode(GROUP_CONTROL_MODE_BLINKING);
+  pca9622.setBlinkingPermille(BLINKING_PERIOD_1_S, BLINKING_PERMILLE_BALANCED);
+  pca9622.setRGB(255, 128, 0);
+
+  return 1;
+}
+
+// Same mode change, recorded once and played as a register program
+static uint32_t modeProgram(PCA9622 &pca9622) {
+
+  PCA9622Recorder recorder;
+  PCA9622ProgramPlayer player(&pca9622);
+  uint8_t program[PCA9622_PROGRAM_MAX_SIZE];
+
+  recorder.begin(&pca9622);
+  modeSequence(pca9622);
+  recorder.end(program, sizeof(program));
+
+  player.play(program);
+
+  return 1;
+}
+
+// Periodic check while the PCA9622 holds the register image
+static uint32_t healthCheck(PCA9622 &pca9622) {
+
+  for (uint8_t i = 0; i < 10; i++) {
+    pca9622.checkHealth();
+  }
+
+  return 10;
+}
+
+// Register image written again after a reset of the PCA9622
+static uint32_t recoverImage(PCA9622 &pca9622) {
+
+  currentModel->reset();
+  pca9622.recover();
+
+  // Only the MODE1 write that starts the oscillator reaches it before it runs
+  CHECK(currentModel->regWritesAsleep() == 1);
+  CHECK(currentModel->reg(REG_LEDOUT0) == 0xAA);
+
+  return 1;
+}
+
+// One rotation of the background verifier through all registers, nothing to repair
+static uint32_t verifyRotation(PCA9622 &pca9622) {
+
+  PCA9622Verifier verifier(&pca9622);
+  uint32_t windows = 0;
+
+  verifier.begin(1000, micros());
+
+  while (windows * PCA9622_VERIFY_WINDOW < PCA9622_NUM_REGS) {
+    if (verifier.update(micros())) {
+      windows++;
+    }
+  }
+
+  return windows;
+}
+
+static uint32_t ldrStateAll(PCA9622 &pca9622) {
+
+  pca9622.setLdrStateAll(LDR_STATE_IND_GRP);
+
+  return 1;
+}
+
+static uint32_t blinkSetup(PCA9622 &pca9622) {
+
+  pca9622.setBlinkingPermille(BLINKING_PERIOD_1_S, BLINKING_PERMILLE_BALANCED);
+  pca9622.setGroupControlMode(GROUP_CONTROL_MODE_BLINKING);
+  pca9622.setLdrStateAll(LDR_STATE_IND_GRP);
+
+  return 1;
+}
+
+// Status pattern on 12 channels for 10s, ticked every 10ms
+static uint32_t blinkPattern(PCA9622 &pca9622) {
+
+  PCA9622Blink slots[1];
+  PCA9622Blinker blinker(slots, 1);
+
+  blinker.blink(&pca9622, 0x0FFF, 500, 100, 0);
+
+  for (uint32_t now = 0; now < 10000; now += 10) {
+    blinker.tick(now);
+  }
+
+  return 1;
+}
+
+// Idle until sleeping, then one frame turning all channels on
+static uint32_t autoSleepWake(PCA9622 &pca9622) {
+
+  pca9622.setAutoSleep(10);
+
+  for (uint8_t i = 0; i < 20; i++) {
+    pca9622.updatePower();
+    delay(1);
+  }
+
+  uint8_t pwm[16];
+
+  memset(pwm, 0x80, sizeof(pwm));
+
+  pca9622.beginFrame();
+  pca9622.setAllPwm(pwm);
+  pca9622.setLdrStateAll(LDR_STATE_IND);
+  pca9622.commitFrame();
+
+  pca9622.setAutoSleep(0);
+
+  return 1;
+}
+
+static uint32_t sleepWakeUp(PCA9622 &pca9622) {
+
+  pca9622.sleep();
+  pca9622.wakeUp();
+
+  return 1;
+}
+
+// Wake-up and PWM values staged in one frame, flushed together
+static uint32_t deferredWakeUp(PCA9622 &pca9622) {
+
+  pca9622.sleep();
+  currentModel->resetCounters();
+
+  pca9622.setDeferred(true);
+  pca9622.wakeUp();
+  pca9622.setPwm(REG_PWM0, 100);
+  pca9622.setPwm(REG_PWM1, 50);
+  pca9622.flush();
+  pca9622.setDeferred(false);
+
+  // Only the MODE1 write that starts the oscillator reaches it before it runs
+  CHECK(currentModel->regWritesAsleep() == 1);
+  CHECK(currentModel->reg(REG_PWM0) == 100 && currentModel->reg(REG_PWM1) == 50);
+
+  return 1;
+}
+
+/********************************* HARNESS ************************************/
+
+static void run(const char *name, Workload workload) {
+
+  PCA9622Model model(DEVICE_ADDRESS);
+  TwoWire wire;
+  PCA9622 pca9622(REG_PWM0, REG_PWM1, REG_PWM2);
+
+  wire.attach(&model);
+  pca9622.begin(DEVICE_ADDRESS, &wire, BUS_CLOCK);
+  pca9622.setLdrStateAll(LDR_STATE_IND);
+
+  wire.resetStats();
+  model.resetCounters();
+  currentModel = &model;
+
+  Result &result = results[numResults++];
+
+  strncpy(result.name, name, sizeof(result.name) - 1);
+  result.name[sizeof(result.name) - 1] = '\0';
+  result.ops = workload(pca9622);
+  result.transfers = wire.stats().starts;
+  result.bytes = wire.stats().bytes;
+  result.busTimeNs = wire.stats().busTimeNs;
+  result.latches = model.latchEvents();
+}
+
+static bool writeResults(const char *path) {
+
+  FILE *file = fopen(path, "w");
+
+  if (file == NULL) {
+    return false;
+  }
+
+  fprintf(file, "workload,ops,transfers,bytes,bus_ns,latches\n");
+
+  for (uint8_t i = 0; i < numResults; i++) {
+    fprintf(file, "%s,%u,%u,%u,%llu,%u\n", results[i].name, results[i].ops,
+            results[i].transfers, results[i].bytes,
+            (unsigned long long) results[i].busTimeNs, results[i].latches);
+  }
+
+  fclose(file);
+
+  return true;
+}
+
+// Returns the number of workloads that got more expensive than the baseline
+static int compareBaseline(const char *path) {
+
+  FILE *file = fopen(path, "r");
+
+  if (file == NULL) {
+    fprintf(stderr, "No baseline at %s, skipping comparison\n", path);
+    return 0;
+  }
+
+  char line[128];
+  int regressions = 0;
+
+  while (fgets(line, sizeof(line), file) != NULL) {
+    char name[32];
+    unsigned ops, transfers, bytes, latches;
+    unsigned long long busTimeNs;
+
+    if (sscanf(line, "%31[^,],%u,%u,%u,%llu,%u", name, &ops, &transfers, &bytes, &busTimeNs, &latches) != 6) {
+      continue;
+    }
+
+    for (uint8_t i = 0; i < numResults; i++) {
+      const Result &result = results[i];
+
+      if (strcmp(result.name, name) != 0) {
+        continue;
+      }
+
+      if (result.transfers > transfers || result.bytes > bytes || result.busTimeNs > busTimeNs
+          || result.latches > latches) {
+        fprintf(stderr, "REGRESSION %s: transfers %u -> %u, bytes %u -> %u, bus_ns %llu -> %llu, latches %u -> %u\n",
+                name, transfers, result.transfers, bytes, result.bytes,
+                busTimeNs, (unsigned long long) result.busTimeNs, latches, result.latches);
+        regressions++;
+      }
+    }
+  }
+
+  fclose(file);
+
+  return regressions;
+}
+
+int main(int argc, char **argv) {
+
+  const char *resultsPath = (argc > 1) ? argv[1] : "benchmark.csv";
+  const char *baselinePath = (argc > 2) ? argv[2] : "extras/benchmark/baseline.csv";
+  bool update = (argc > 3) && strcmp(argv[3], "--update") == 0;
+
+  run("rgb_frame", rgbFrame);
+  run("rgb_frame_deferred", rgbFrameDeferred);
+  run("rgb_frame_commit", rgbFrameCommit);
+  run("fixture_views", fixtureViews);
+  run("flush_failure", flushFailure);
+  run("all_pwm_frame", allPwmFrame);
+  run("channel_fades", channelFades);
+  run("turn_off_on", turnOffOn);
+  run("scene_switch", sceneSwitch);
+  run("snapshot_restore", snapshotRestore);
+  run("mode_sequence", modeSequence);
+  run("mode_program", modeProgram);
+  run("health_check", healthCheck);
+  run("recover_image", recoverImage);
+  run("verify_rotation", verifyRotation);
+  run("ldr_state_all", ldrStateAll);
+  run("blink_setup", blinkSetup);
+  run("blink_pattern", blinkPattern);
+  run("sleep_wake_up", sleepWakeUp);
+  run("deferred_wake_up", deferredWakeUp);
+  run("auto_sleep_wake", autoSleepWake);
+
+  printf("%-20s %6s %10s %8s %12s %8s\n", "workload", "ops", "transfers", "bytes", "us/op", "latches");
+
+  for (uint8_t i = 0; i < numResults; i++) {
+    printf("%-20s %6u %10u %8u %12.1f %8u\n", results[i].name, results[i].ops,
+           results[i].transfers, results[i].bytes,
+           results[i].busTimeNs / 1000.0 / results[i].ops, results[i].latches);
+  }
+
+  if (checkFailures > 0) {
+    fprintf(stderr, "%u checks failed\n", checkFailures);
+    return 1;
+  }
+
+  if (!writeResults(update ? baselinePath : resultsPath)) {
+    fprintf(stderr, "Cannot write results\n");
+    return 2;
+  }
+
+  if (update) {
+    return 0;
+  }
+
+  return (compareBaseline(baselinePath) > 0) ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#include "Arduino.h"
+
+#include <atomic>
+
+// Shared by all simulated buses. Buses driven from several threads add up
+// their bus time, simulated time does not model parallel transfers
+static std::atomic<uint64_t> _timeNs(0);
+
+static uint8_t _pinMode[HOST_NUM_PINS];
+static uint8_t _pinValue[HOST_NUM_PINS];
+static HostPins *_pins = NULL;
+
+unsigned long millis() {
+
+  return (unsigned long) (_timeNs / 1000000);
+}
+
+unsigned long micros() {
+
+  return (unsigned long) (_timeNs / 1000);
+}
+
+void delay(unsigned long ms) {
+
+  _timeNs += (uint64_t) ms * 1000000;
+}
+
+void delayMicroseconds(unsigned int us) {
+
+  _timeNs += (uint64_t) us * 1000;
+}
+
+void hostAdvanceNs(uint64_t ns) {
+
+  _timeNs += ns;
+}
+
+uint64_t hostTimeNs() {
+
+  return _timeNs;
+}
+
+static bool drivenLow(uint8_t pin) {
+
+  return _pinMode[pin] == OUTPUT && _pinValue[pin] == LOW;
+}
+
+static void updatePin(uint8_t pin, uint8_t mode, uint8_t value) {
+
+  bool wasLow = drivenLow(pin);
+
+  _pinMode[pin] = mode;
+  _pinValue[pin] = value;
+
+  if (_pins != NULL && drivenLow(pin) != wasLow) {
+    _pins->pinDriven(pin, !wasLow);
+  }
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+
+  if (pin < HOST_NUM_PINS) {
+    updatePin(pin, mode, _pinValue[pin]);
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+
+  if (pin < HOST_NUM_PINS) {
+    updatePin(pin, _pinMode[pin], value);
+  }
+}
+
+int digitalRead(uint8_t pin) {
+
+  if (pin >= HOST_NUM_PINS || drivenLow(pin) || (_pins != NULL && _pins->pinPulledLow(pin))) {
+    return LOW;
+  }
+
+  return HIGH;
+}
+
+void hostAttachPins(HostPins *pins) {
+
+  _pins = pins;
+}
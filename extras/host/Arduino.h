@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Minimal stand-in for the Arduino core to build the PCA9622 driver on a
+// host. Time is simulated: it only advances through delay(),
+// delayMicroseconds() and traffic on a simulated TwoWire bus. Pins read
+// HIGH (bus pull-ups) unless the MCU or simulated hardware pulls them low
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef uint8_t byte;
+
+#define LOW  0
+#define HIGH 1
+
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+
+#define HOST_NUM_PINS 64 // Pins 0 to 63
+
+/**
+ * Milliseconds of simulated time since start
+ */
+unsigned long millis();
+
+/**
+ * Microseconds of simulated time since start
+ */
+unsigned long micros();
+
+/**
+ * Advance simulated time
+ *
+ * @param ms Milliseconds to wait
+ */
+void delay(unsigned long ms);
+
+/**
+ * Advance simulated time
+ *
+ * @param us Microseconds to wait
+ */
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+/**
+ * Simulated hardware connected to pins, e.g. the lines of a TwoWire bus
+ */
+class HostPins {
+
+public:
+
+    virtual ~HostPins() {}
+
+    /**
+     * The MCU started or stopped pulling a pin low
+     *
+     * @param pin Pin number
+     * @param low true if the MCU pulls the pin low
+     */
+    virtual void pinDriven(uint8_t pin, bool low) = 0;
+
+    /**
+     * @param pin Pin number
+     *
+     * @return true if the hardware pulls the pin low
+     */
+    virtual bool pinPulledLow(uint8_t pin) = 0;
+};
+
+/**
+ * Connect simulated hardware to the pins
+ *
+ * @param pins Hardware, NULL to disconnect
+ */
+void hostAttachPins(HostPins *pins);
+
+/**
+ * Advance simulated time with nanosecond resolution. Used by the simulated
+ * bus to account for transfer time
+ *
+ * @param ns Nanoseconds to advance
+ */
+void hostAdvanceNs(uint64_t ns);
+
+/**
+ * Simulated time in nanoseconds since start
+ */
+uint64_t hostTimeNs();
+
+#endif //HOST_ARDUINO_H
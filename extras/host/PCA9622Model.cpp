@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#include "PCA9622Model.h"
+
+#define M_MODE1      0x00
+#define M_MODE2      0x01
+#define M_PWM0       0x02
+#define M_PWM15      0x11
+#define M_GRPPWM     0x12
+#define M_GRPFREQ    0x13
+#define M_LEDOUT3    0x17
+#define M_SUBADR1    0x18
+#define M_SUBADR2    0x19
+#define M_SUBADR3    0x1A
+#define M_ALLCALLADR 0x1B
+
+#define M_MODE1_AI    0xE0 // AI[2:0], read only
+#define M_MODE1_SLEEP 0x10
+#define M_MODE1_SUB1  0x08
+#define M_MODE1_SUB2  0x04
+#define M_MODE1_SUB3  0x02
+#define M_MODE1_ALL   0x01
+#define M_MODE2_OCH   0x08
+
+PCA9622Model::PCA9622Model(uint8_t deviceAddress) {
+
+  _deviceAddress = deviceAddress;
+  _nackCount = 0;
+  _connected = true;
+
+  reset();
+}
+
+void PCA9622Model::reset() {
+
+  memset(_reg, 0, sizeof(_reg));
+
+  // Power-up defaults (page 10, table 5)
+  _reg[M_MODE1] = M_MODE1_SLEEP | M_MODE1_ALL;
+  _reg[M_MODE2] = 0x05;
+  _reg[M_GRPPWM] = 0xFF;
+  _reg[M_SUBADR1] = 0xE2;
+  _reg[M_SUBADR2] = 0xE4;
+  _reg[M_SUBADR3] = 0xE8;
+  _reg[M_ALLCALLADR] = 0xE0;
+
+  memcpy(_out, _reg, sizeof(_out));
+
+  _pointer = 0;
+  _ai = 0;
+  _selected = false;
+  _expectControl = false;
+  _pendingLatch = false;
+  _wakeNs = 0;
+
+  resetCounters();
+}
+
+uint8_t PCA9622Model::reg(uint8_t registerAddress) const {
+
+  return (registerAddress < MODEL_NUM_REGS) ? _reg[registerAddress] : 0;
+}
+
+uint8_t PCA9622Model::output(uint8_t registerAddress) const {
+
+  return (registerAddress < MODEL_NUM_REGS) ? _out[registerAddress] : 0;
+}
+
+bool PCA9622Model::isSleeping() const {
+
+  return _reg[M_MODE1] & M_MODE1_SLEEP;
+}
+
+bool PCA9622Model::isOscillatorRunning() const {
+
+  return !isSleeping() && hostTimeNs() >= _wakeNs;
+}
+
+uint32_t PCA9622Model::latchEvents() const {
+
+  return _latchEvents;
+}
+
+uint32_t PCA9622Model::regWrites() const {
+
+  return _regWrites;
+}
+
+uint32_t PCA9622Model::regWritesAsleep() const {
+
+  return _regWritesAsleep;
+}
+
+void PCA9622Model::resetCounters() {
+
+  _latchEvents = 0;
+  _regWrites = 0;
+  _regWritesAsleep = 0;
+}
+
+void PCA9622Model::nackNext(uint16_t count) {
+
+  _nackCount = count;
+}
+
+void PCA9622Model::setConnected(bool connected) {
+
+  _connected = connected;
+}
+
+bool PCA9622Model::select(uint8_t address, bool read) {
+
+  uint8_t mode1 = _reg[M_MODE1];
+
+  _selected = false;
+  _expectControl = false;
+
+  if (!_connected) {
+    return false;
+  }
+
+  _selected = (address == _deviceAddress);
+
+  // Sub and All Call addresses only accept writes
+  if (!read) {
+    _selected |= (mode1 & M_MODE1_SUB1) && address == (_reg[M_SUBADR1] >> 1);
+    _selected |= (mode1 & M_MODE1_SUB2) && address == (_reg[M_SUBADR2] >> 1);
+    _selected |= (mode1 & M_MODE1_SUB3) && address == (_reg[M_SUBADR3] >> 1);
+    _selected |= (mode1 & M_MODE1_ALL) && address == (_reg[M_ALLCALLADR] >> 1);
+  }
+
+  if (_selected && _nackCount > 0) {
+    _nackCount--;
+    _selected = false;
+  }
+
+  _expectControl = _selected && !read;
+
+  return _selected;
+}
+
+bool PCA9622Model::receive(uint8_t data) {
+
+  if (!_selected) {
+    return false;
+  }
+
+  if (_expectControl) {
+    _pointer = data & 0x1F;
+    _ai = data >> 5;
+    _reg[M_MODE1] = (_reg[M_MODE1] & ~M_MODE1_AI) | (_ai << 5);
+    _expectControl = false;
+    return true;
+  }
+
+  if (_pointer < MODEL_NUM_REGS) {
+    if (_pointer == M_MODE1) {
+      bool wasSleeping = isSleeping();
+
+      _reg[M_MODE1] = (_reg[M_MODE1] & M_MODE1_AI) | (data & ~M_MODE1_AI);
+
+      if (wasSleeping && !isSleeping()) {
+        _wakeNs = hostTimeNs() + (uint64_t) MODEL_OSC_STARTUP_US * 1000;
+      }
+    }
+    else {
+      _reg[_pointer] = data;
+    }
+
+    _regWrites++;
+    if (!isOscillatorRunning()) {
+      _regWritesAsleep++;
+    }
+
+    if (_pointer >= M_PWM0 && _pointer <= M_LEDOUT3) {
+      if (_reg[M_MODE2] & M_MODE2_OCH) {
+        latch();
+      }
+      else {
+        _pendingLatch = true;
+      }
+    }
+  }
+
+  advance();
+
+  return true;
+}
+
+uint8_t PCA9622Model::transmit() {
+
+  uint8_t data = (_pointer < MODEL_NUM_REGS) ? _reg[_pointer] : 0;
+
+  advance();
+
+  return data;
+}
+
+void PCA9622Model::stop() {
+
+  _selected = false;
+  _expectControl = false;
+
+  if (_pendingLatch) {
+    latch();
+  }
+}
+
+/****************************** PRIVATE METHODS *******************************/
+
+void PCA9622Model::advance() {
+
+  // Auto-Increment options (page 9, table 4)
+  switch (_ai) {
+    case 4: // All registers
+      _pointer = (_pointer >= M_ALLCALLADR) ? M_MODE1 : _pointer + 1;
+      break;
+
+    case 5: // Individual brightness registers only
+      _pointer = (_pointer >= M_PWM15) ? M_PWM0 : _pointer + 1;
+      break;
+
+    case 6: // Global control registers only
+      _pointer = (_pointer >= M_GRPFREQ) ? M_GRPPWM : _pointer + 1;
+      break;
+
+    case 7: // Individual and global control registers
+      _pointer = (_pointer >= M_GRPFREQ) ? M_PWM0 : _pointer + 1;
+      break;
+
+    default: // No Auto-Increment
+      break;
+  }
+}
+
+void PCA9622Model::latch() {
+
+  _pendingLatch = false;
+
+  if (memcmp(&_out[M_PWM0], &_reg[M_PWM0], M_LEDOUT3 - M_PWM0 + 1) != 0) {
+    memcpy(&_out[M_PWM0], &_reg[M_PWM0], M_LEDOUT3 - M_PWM0 + 1);
+    _latchEvents++;
+  }
+}
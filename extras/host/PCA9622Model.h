@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef PCA9622_MODEL_H
+#define PCA9622_MODEL_H
+
+#include "Wire.h"
+
+// Register model of the PCA9622 for the simulated bus. Register map,
+// power-up defaults, control register, Auto-Increment rollover (page 9,
+// table 4), SLEEP and OCH follow the datasheet. Register definitions are
+// not shared with the driver on purpose, so the model stays an independent
+// reference
+
+#define MODEL_NUM_REGS       28  // MODE1 to ALLCALLADR
+#define MODEL_OSC_STARTUP_US 500 // Oscillator start-up time after clearing SLEEP
+
+class PCA9622Model : public I2CDevice {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Constructor for the PCA9622 model
+     *
+     * @param deviceAddress 7-bit I2C address of the simulated device
+     */
+    PCA9622Model(uint8_t deviceAddress);
+
+    /**
+     * Power-on reset, all registers get their default values
+     */
+    void reset();
+
+    /**
+     * @param registerAddress Register address
+     *
+     * @return register content as seen through the I2C interface
+     */
+    uint8_t reg(uint8_t registerAddress) const;
+
+    /**
+     * @param registerAddress Register address of PWMx, GRPPWM, GRPFREQ or LEDOUTx
+     *
+     * @return register content currently applied to the outputs. Differs
+     *         from reg() until the outputs changed (on STOP or ACK, see OCH)
+     */
+    uint8_t output(uint8_t registerAddress) const;
+
+    /**
+     * @return true if SLEEP is set in MODE1
+     */
+    bool isSleeping() const;
+
+    /**
+     * @return true if the oscillator is running, i.e. SLEEP is cleared and
+     *         the start-up time has passed
+     */
+    bool isOscillatorRunning() const;
+
+    /**
+     * @return number of times the outputs changed
+     */
+    uint32_t latchEvents() const;
+
+    /**
+     * @return number of register writes
+     */
+    uint32_t regWrites() const;
+
+    /**
+     * @return number of register writes while the oscillator was not running
+     */
+    uint32_t regWritesAsleep() const;
+
+    /**
+     * Clear the latch event and register write counters
+     */
+    void resetCounters();
+
+    /**
+     * Fault injection: do not acknowledge the next address phases
+     *
+     * @param count Number of address phases to NACK
+     */
+    void nackNext(uint16_t count);
+
+    /**
+     * Fault injection: a disconnected device does not acknowledge anything
+     *
+     * @param connected false to disconnect the device from the bus
+     */
+    void setConnected(bool connected);
+
+    bool select(uint8_t address, bool read);
+    bool receive(uint8_t data);
+    uint8_t transmit();
+    void stop();
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+    /**
+     * Advance the register pointer according to the Auto-Increment flags
+     */
+    void advance();
+
+    /**
+     * Apply the register content to the outputs
+     */
+    void latch();
+
+    uint8_t _deviceAddress;
+    uint8_t _reg[MODEL_NUM_REGS];
+    uint8_t _out[MODEL_NUM_REGS];
+
+    /**
+     * Register pointer D[4:0] and Auto-Increment flags AI[2:0] of the
+     * control register
+     */
+    uint8_t _pointer;
+    uint8_t _ai;
+
+    bool _selected;
+    bool _expectControl;
+    bool _pendingLatch;
+
+    uint16_t _nackCount;
+    bool _connected;
+
+    uint64_t _wakeNs;
+    uint32_t _latchEvents;
+    uint32_t _regWrites;
+    uint32_t _regWritesAsleep;
+};
+
+#endif //PCA9622_MODEL_H
@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#include "Wire.h"
+
+TwoWire Wire;
+
+TwoWire::TwoWire() {
+
+  _numDevices = 0;
+  _numSelected = 0;
+  _txAddress = 0;
+  _txLength = 0;
+  _txOverflow = false;
+  _rxLength = 0;
+  _rxIndex = 0;
+  _busHeld = false;
+  _clock = 100000;
+  _sdaPin = 0xFF;
+  _sclPin = 0xFF;
+  _sclLow = false;
+  _sdaHeld = 0;
+
+  resetStats();
+}
+
+void TwoWire::begin() {
+}
+
+void TwoWire::end() {
+}
+
+void TwoWire::setClock(uint32_t clock) {
+
+  _clock = clock;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+
+  _txAddress = address;
+  _txLength = 0;
+  _txOverflow = false;
+}
+
+uint8_t TwoWire::endTransmission() {
+
+  return endTransmission(true);
+}
+
+    /**
+     * Return values as in the AVR core:
+     *   0: success
+     *   1: data too long to fit in transmit buffer
+     *   2: received NACK on transmit of address
+     *   3: received NACK on transmit of data
+     *   4: other error, here SDA held low (lost arbitration)
+     */
+uint8_t TwoWire::endTransmission(uint8_t sendStop) {
+
+  if (_txOverflow) {
+    return 1;
+  }
+
+  if (_sdaHeld > 0) {
+    _txLength = 0;
+    clock(1);
+    return 4;
+  }
+
+  uint8_t result = 0;
+
+  if (start(_txAddress, false) == 0) {
+    result = 2;
+  }
+  else {
+    for (uint8_t i = 0; i < _txLength; i++) {
+      bool ack = false;
+
+      for (uint8_t d = 0; d < _numSelected; d++) {
+        ack |= _selected[d]->receive(_txBuffer[i]);
+      }
+
+      _stats.bytes++;
+      clock(9);
+
+      if (!ack) {
+        _stats.nacks++;
+        result = 3;
+        break;
+      }
+    }
+  }
+
+  if (sendStop || result != 0) {
+    stop();
+  }
+  else {
+    _busHeld = true;
+  }
+
+  _txLength = 0;
+
+  return result;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity) {
+
+  return requestFrom(address, quantity, true);
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop) {
+
+  if (quantity > BUFFER_LENGTH) {
+    quantity = BUFFER_LENGTH;
+  }
+
+  _rxIndex = 0;
+  _rxLength = 0;
+
+  if (_sdaHeld > 0) {
+    clock(1);
+    return 0;
+  }
+
+  if (start(address, true) == 0) {
+    stop();
+    return 0;
+  }
+
+  for (uint8_t i = 0; i < quantity; i++) {
+    _rxBuffer[i] = _selected[0]->transmit();
+    _stats.bytes++;
+    clock(9);
+  }
+
+  _rxLength = quantity;
+
+  if (sendStop) {
+    stop();
+  }
+  else {
+    _busHeld = true;
+  }
+
+  return quantity;
+}
+
+size_t TwoWire::write(uint8_t data) {
+
+  if (_txLength >= BUFFER_LENGTH) {
+    _txOverflow = true;
+    return 0;
+  }
+
+  _txBuffer[_txLength++] = data;
+
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t quantity) {
+
+  for (size_t i = 0; i < quantity; i++) {
+    if (write(data[i]) == 0) {
+      return i;
+    }
+  }
+
+  return quantity;
+}
+
+int TwoWire::available() {
+
+  return _rxLength - _rxIndex;
+}
+
+int TwoWire::read() {
+
+  if (_rxIndex < _rxLength) {
+    return _rxBuffer[_rxIndex++];
+  }
+
+  return -1;
+}
+
+int TwoWire::peek() {
+
+  if (_rxIndex < _rxLength) {
+    return _rxBuffer[_rxIndex];
+  }
+
+  return -1;
+}
+
+void TwoWire::attach(I2CDevice *device) {
+
+  if (_numDevices < WIRE_MAX_DEVICES) {
+    _devices[_numDevices++] = device;
+  }
+}
+
+void TwoWire::detach(I2CDevice *device) {
+
+  for (uint8_t i = 0; i < _numDevices; i++) {
+    if (_devices[i] == device) {
+      _devices[i] = _devices[--_numDevices];
+      return;
+    }
+  }
+}
+
+uint32_t TwoWire::getClock() const {
+
+  return _clock;
+}
+
+const I2CBusStats &TwoWire::stats() const {
+
+  return _stats;
+}
+
+void TwoWire::simulatePins(uint8_t sdaPin, uint8_t sclPin) {
+
+  _sdaPin = sdaPin;
+  _sclPin = sclPin;
+
+  hostAttachPins(this);
+}
+
+void TwoWire::holdSda(uint8_t pulses) {
+
+  _sdaHeld = pulses;
+}
+
+void TwoWire::pinDriven(uint8_t pin, bool low) {
+
+  if (pin != _sclPin) {
+    return;
+  }
+
+  // A device shifts out a bit on each SCL pulse
+  if (_sclLow && !low && _sdaHeld > 0) {
+    _sdaHeld--;
+  }
+  _sclLow = low;
+}
+
+bool TwoWire::pinPulledLow(uint8_t pin) {
+
+  return pin == _sdaPin && _sdaHeld > 0;
+}
+
+void TwoWire::resetStats() {
+
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+/****************************** PRIVATE METHODS *******************************/
+
+uint8_t TwoWire::start(uint8_t address, bool read) {
+
+  _stats.starts++;
+  clock(1);
+
+  _numSelected = 0;
+
+  for (uint8_t i = 0; i < _numDevices; i++) {
+    if (_devices[i]->select(address, read)) {
+      _selected[_numSelected++] = _devices[i];
+    }
+  }
+
+  _stats.bytes++;
+  clock(9);
+
+  if (_numSelected == 0) {
+    _stats.nacks++;
+  }
+
+  _busHeld = false;
+
+  return _numSelected;
+}
+
+void TwoWire::stop() {
+
+  _stats.stops++;
+  clock(1);
+
+  for (uint8_t i = 0; i < _numDevices; i++) {
+    _devices[i]->stop();
+  }
+
+  _numSelected = 0;
+
+  // Bus free time between STOP and START (tBUF)
+  uint64_t freeNs = (_clock > 400000) ? 500 : (_clock > 100000) ? 1300 : 4700;
+
+  _stats.busTimeNs += freeNs;
+  hostAdvanceNs(freeNs);
+}
+
+void TwoWire::clock(uint32_t cycles) {
+
+  uint64_t ns = (uint64_t) cycles * 1000000000 / _clock;
+
+  _stats.clocks += cycles;
+  _stats.busTimeNs += ns;
+  hostAdvanceNs(ns);
+}
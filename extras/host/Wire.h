@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+// Stand-in for the Arduino TwoWire class on a host. Transfers are delivered
+// to simulated I2C devices attached to the bus, and every START, STOP and
+// byte is counted and converted into simulated bus time. With
+// simulatePins(), the bus lines can be read and clocked through the pin
+// functions, e.g. for a bus clear
+
+#include "Arduino.h"
+
+#define BUFFER_LENGTH 32 // Same transmit/receive buffer size as the AVR core
+
+#define WIRE_MAX_DEVICES 32 // Maximum number of devices attached to one bus
+
+/**
+ * Simulated device on the I2C bus
+ */
+class I2CDevice {
+
+public:
+
+    virtual ~I2CDevice() {}
+
+    /**
+     * Address phase after a START or repeated START
+     *
+     * @param address 7-bit address sent by the master
+     * @param read    true for a read transfer
+     *
+     * @return true if the device acknowledges the address
+     */
+    virtual bool select(uint8_t address, bool read) = 0;
+
+    /**
+     * Byte written by the master
+     *
+     * @param data Byte received by the device
+     *
+     * @return true if the device acknowledges the byte
+     */
+    virtual bool receive(uint8_t data) = 0;
+
+    /**
+     * Byte read by the master
+     *
+     * @return byte sent by the device
+     */
+    virtual uint8_t transmit() = 0;
+
+    /**
+     * STOP condition on the bus
+     */
+    virtual void stop() = 0;
+};
+
+/**
+ * Traffic counters of a simulated bus
+ */
+struct I2CBusStats {
+    uint32_t starts;    // START and repeated START conditions
+    uint32_t stops;     // STOP conditions
+    uint32_t bytes;     // Bytes on the bus, including address bytes
+    uint32_t nacks;     // Bytes not acknowledged
+    uint64_t clocks;    // SCL cycles, including START and STOP
+    uint64_t busTimeNs; // Simulated bus time, including bus free time after STOP
+};
+
+class TwoWire : public HostPins {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    TwoWire();
+
+    void begin();
+    void end();
+
+    /**
+     * Set the SCL clock frequency used to compute bus time
+     *
+     * @param clock Clock in Hz, e.g. 100000, 400000 or 1000000
+     */
+    void setClock(uint32_t clock);
+
+    void beginTransmission(uint8_t address);
+    uint8_t endTransmission();
+    uint8_t endTransmission(uint8_t sendStop);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop);
+    size_t write(uint8_t data);
+    size_t write(const uint8_t *data, size_t quantity);
+    int available();
+    int read();
+    int peek();
+
+    /**
+     * Attach a simulated device to the bus
+     *
+     * @param device Device to attach
+     */
+    void attach(I2CDevice *device);
+
+    /**
+     * Detach a simulated device from the bus
+     *
+     * @param device Device to detach
+     */
+    void detach(I2CDevice *device);
+
+    /**
+     * Connect the bus lines to pins, see hostAttachPins()
+     *
+     * @param sdaPin Pin number of SDA
+     * @param sclPin Pin number of SCL
+     */
+    void simulatePins(uint8_t sdaPin, uint8_t sclPin);
+
+    /**
+     * Fault injection: a device holds SDA low, e.g. after it was reset in
+     * the middle of a read. Transfers fail with 4 (other error) until SDA
+     * is released after the given number of SCL pulses on the SCL pin
+     *
+     * @param pulses SCL pulses until SDA is released
+     */
+    void holdSda(uint8_t pulses);
+
+    void pinDriven(uint8_t pin, bool low);
+    bool pinPulledLow(uint8_t pin);
+
+    /**
+     * @return SCL clock frequency in Hz
+     */
+    uint32_t getClock() const;
+
+    /**
+     * @return traffic counters since the last resetStats()
+     */
+    const I2CBusStats &stats() const;
+
+    /**
+     * Clear the traffic counters
+     */
+    void resetStats();
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+    /**
+     * Generate a START (or repeated START) and send the address byte
+     *
+     * @return number of devices that acknowledged
+     */
+    uint8_t start(uint8_t address, bool read);
+
+    /**
+     * Generate a STOP and notify the devices
+     */
+    void stop();
+
+    /**
+     * Account for a number of SCL cycles
+     */
+    void clock(uint32_t cycles);
+
+    I2CDevice *_devices[WIRE_MAX_DEVICES];
+    uint8_t _numDevices;
+
+    /**
+     * Devices that acknowledged the current address phase
+     */
+    I2CDevice *_selected[WIRE_MAX_DEVICES];
+    uint8_t _numSelected;
+
+    uint8_t _txAddress;
+    uint8_t _txBuffer[BUFFER_LENGTH];
+    uint8_t _txLength;
+    bool _txOverflow;
+
+    uint8_t _rxBuffer[BUFFER_LENGTH];
+    uint8_t _rxLength;
+    uint8_t _rxIndex;
+
+    /**
+     * Indicates that the last transfer ended without STOP
+     */
+    bool _busHeld;
+
+    uint32_t _clock;
+    I2CBusStats _stats;
+
+    uint8_t _sdaPin;
+    uint8_t _sclPin;
+    bool _sclLow;
+
+    /**
+     * SCL pulses until a device releases SDA, 0 if SDA is free
+     */
+    uint8_t _sdaHeld;
+};
+
+extern TwoWire Wire;
+
+#endif //HOST_WIRE_H
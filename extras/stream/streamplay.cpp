@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+// Plays a frame stream (see PCA9622Stream.h) against simulated devices (see
+// extras/host) and reports how far playback drifted from the frame times.
+// Can also write a demo stream.
+//
+// Usage: streamplay play <show.p9s> [clock] [window]
+//        streamplay demo <show.p9s> [devices] [seconds] [fps]
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PCA9622.h"
+#include "PCA9622Model.h"
+#include "PCA9622Stream.h"
+
+#define MAX_DEVICES   16
+#define FIRST_ADDRESS 0x20
+#define STEP_US       50 // Resolution of simulated playback
+#define MAX_GAP       2  // Unchanged registers bridged within one record
+
+/********************************* ENCODER ************************************/
+
+static void putVarint(FILE *file, uint32_t value) {
+
+  do {
+    uint8_t byte = value & 0x7F;
+
+    value >>= 7;
+    fputc(value ? byte | 0x80 : byte, file);
+  } while (value);
+}
+
+// Emit the changed registers of one device as records, bridging small gaps
+static uint8_t encodeDevice(FILE *file, uint8_t device, const uint8_t *prev, const uint8_t *next) {
+
+  uint8_t records = 0;
+  uint8_t reg = 0;
+
+  while (reg < PCA9622_NUM_REGS) {
+    if (prev[reg] == next[reg]) {
+      reg++;
+      continue;
+    }
+
+    uint8_t first = reg;
+    uint8_t last = reg;
+
+    for (reg = first + 1; reg < PCA9622_NUM_REGS && reg - last <= MAX_GAP + 1; reg++) {
+      if (prev[reg] != next[reg]) {
+        last = reg;
+      }
+    }
+
+    uint8_t count = last - first + 1;
+    bool same = count >= 3;
+
+    for (uint8_t i = first + 1; i <= last && same; i++) {
+      same = next[i] == next[first];
+    }
+
+    if (file != NULL) {
+      fputc(device, file);
+      fputc(first | (same ? STREAM_RECORD_FILL : 0), file);
+      fputc(count, file);
+      fwrite(&next[first], 1, same ? 1 : count, file);
+    }
+
+    records++;
+    reg = last + 1;
+  }
+
+  return records;
+}
+
+// Chase of a bright spot over all channels of all devices, fading behind it
+static void demoImage(uint8_t devices, uint32_t frame, uint8_t image[][PCA9622_NUM_REGS]) {
+
+  uint16_t channels = devices * 16;
+  uint16_t head = (frame / 2) % channels;
+
+  for (uint16_t channel = 0; channel < channels; channel++) {
+    uint16_t distance = (head + channels - channel) % channels;
+    uint8_t *reg = image[channel / 16];
+
+    reg[REG_PWM0 + channel % 16] = (distance < 8) ? 255 >> distance : 0;
+  }
+
+  for (uint8_t device = 0; device < devices; device++) {
+    image[device][REG_GRPPWM] = 0xFF;
+    memset(&image[device][REG_LEDOUT0], 0xAA, 4); // LDR_STATE_IND
+  }
+}
+
+static int demo(const char *path, uint8_t devices, uint32_t seconds, uint32_t fps) {
+
+  static uint8_t prev[MAX_DEVICES][PCA9622_NUM_REGS];
+  static uint8_t next[MAX_DEVICES][PCA9622_NUM_REGS];
+  FILE *file = fopen(path, "wb");
+
+  if (file == NULL || devices == 0 || devices > MAX_DEVICES || fps == 0 || fps > 1000) {
+    fprintf(stderr, "Cannot write %s\n", path);
+    return 2;
+  }
+
+  const uint8_t header[PCA9622_STREAM_HEADER_SIZE] = { 'P', '9', 'S', PCA9622_STREAM_VERSION, devices };
+
+  fwrite(header, 1, sizeof(header), file);
+
+  uint32_t frames = seconds * fps;
+  uint32_t lastMs = 0;
+
+  for (uint32_t frame = 0; frame < frames; frame++) {
+    uint32_t ms = frame * 1000 / fps;
+    uint8_t records = 0;
+
+    demoImage(devices, frame, next);
+
+    if (frame == 0) {
+      // Key frame: the state of the devices is unknown, send all outputs
+      for (uint8_t device = 0; device < devices; device++) {
+        for (uint8_t reg = REG_PWM0; reg <= REG_LEDOUT3; reg++) {
+          prev[device][reg] = ~next[device][reg];
+        }
+      }
+    }
+
+    for (uint8_t device = 0; device < devices; device++) {
+      records += encodeDevice(NULL, device, prev[device], next[device]);
+    }
+
+    putVarint(file, ms - lastMs);
+    fputc(records, file);
+
+    for (uint8_t device = 0; device < devices; device++) {
+      encodeDevice(file, device, prev[device], next[device]);
+    }
+
+    memcpy(prev, next, sizeof(prev));
+    lastMs = ms;
+  }
+
+  printf("%u frames, %u devices, %ld bytes\n", frames, devices, ftell(file));
+  fclose(file);
+
+  return 0;
+}
+
+/********************************** PLAYER ************************************/
+
+static int play(const char *path, uint32_t clock, uint16_t windowSize) {
+
+  int fd = open(path, O_RDONLY);
+  struct stat info;
+
+  if (fd < 0 || fstat(fd, &info) != 0 || info.st_size < PCA9622_STREAM_HEADER_SIZE) {
+    fprintf(stderr, "Cannot read %s\n", path);
+    return 2;
+  }
+
+  const uint8_t *data = (const uint8_t *) mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  if (data == MAP_FAILED) {
+    fprintf(stderr, "Cannot map %s\n", path);
+    return 2;
+  }
+
+  uint8_t numDevices = data[PCA9622_STREAM_HEADER_SIZE - 1];
+
+  if (numDevices > MAX_DEVICES) {
+    fprintf(stderr, "Too many devices: %u\n", numDevices);
+    return 2;
+  }
+
+  static PCA9622Model *models[MAX_DEVICES];
+  static PCA9622 *devices[MAX_DEVICES];
+
+  for (uint8_t i = 0; i < numDevices; i++) {
+    models[i] = new PCA9622Model(FIRST_ADDRESS + i);
+    devices[i] = new PCA9622(REG_PWM0, REG_PWM1, REG_PWM2);
+
+    Wire.attach(models[i]);
+    devices[i]->begin(FIRST_ADDRESS + i, &Wire, clock);
+  }
+
+  uint8_t *window = new uint8_t[windowSize];
+  PCA9622MemorySource source(data, info.st_size);
+  PCA9622StreamPlayer player(devices, numDevices, window, windowSize);
+
+  Wire.resetStats();
+
+  uint32_t start = micros();
+  uint8_t status = player.begin(&source, start);
+  uint64_t driftSum = 0;
+  uint32_t frames = 0;
+
+  while (status == STREAM_PLAYING) {
+    status = player.update(micros());
+
+    if (player.frames() != frames) {
+      driftSum += (uint64_t) player.lastDriftMicros() * (player.frames() - frames);
+      frames = player.frames();
+    }
+
+    delayMicroseconds(STEP_US);
+  }
+
+  if (status != STREAM_END) {
+    fprintf(stderr, "Stream error %u after %u frames\n", status, frames);
+    return 1;
+  }
+
+  uint32_t elapsed = micros() - start;
+  const I2CBusStats &bus = Wire.stats();
+
+  printf("frames        %u\n", frames);
+  printf("devices       %u\n", numDevices);
+  printf("stream bytes  %ld\n", (long) info.st_size);
+  printf("window bytes  %u\n", windowSize);
+  printf("played in     %.3f s\n", elapsed / 1e6);
+  printf("drift avg     %.1f us\n", frames ? (double) driftSum / frames : 0.0);
+  printf("drift max     %u us\n", player.maxDriftMicros());
+  printf("underruns     %u\n", player.underruns());
+  printf("transfers     %lu\n", (unsigned long) bus.starts);
+  printf("bus bytes     %lu\n", (unsigned long) bus.bytes);
+  printf("bus busy      %.1f %%\n", elapsed ? bus.busTimeNs / 10.0 / elapsed : 0.0);
+
+  munmap((void *) data, info.st_size);
+  close(fd);
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+
+  if (argc >= 3 && strcmp(argv[1], "play") == 0) {
+    uint32_t clock = (argc > 3) ? atol(argv[3]) : PCA9622_CLOCK_FAST_PLUS;
+    uint16_t window = (argc > 4) ? atoi(argv[4]) : 64;
+
+    return play(argv[2], clock, window);
+  }
+
+  if (argc >= 3 && strcmp(argv[1], "demo") == 0) {
+    uint8_t devices = (argc > 3) ? atoi(argv[3]) : 4;
+    uint32_t seconds = (argc > 4) ? atol(argv[4]) : 10;
+    uint32_t fps = (argc > 5) ? atol(argv[5]) : 50;
+
+    return demo(argv[2], devices, seconds, fps);
+  }
+
+  fprintf(stderr, "Usage: %s play <show.p9s> [clock] [window]\n"
+                  "       %s demo <show.p9s> [devices] [seconds] [fps]\n", argv[0], argv[0]);
+
+  return 2;
+}
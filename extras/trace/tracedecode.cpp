@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+// Decodes a trace dump (see PCA9622Trace.h), e.g. a Serial log, into bus
+// time per device and a histogram of transfer durations. Lines that are
+// not trace entries are skipped. Built with PCA9622_TRACE, it can also
+// write a dump of simulated traffic.
+//
+// Usage: tracedecode <dump.txt>
+//        tracedecode demo <dump.txt> [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PCA9622.h"
+#include "PCA9622Model.h"
+#include "PCA9622Trace.h"
+
+#define NUM_ADDRESSES 128
+#define NUM_BUCKETS   10 // Durations below 16 us, 16 us to 32 us, ..., 4 ms and more
+#define BAR_WIDTH     40
+
+struct DeviceTrace {
+    uint32_t writes;
+    uint32_t reads;
+    uint32_t errors;
+    uint32_t bytes;
+    uint64_t busMicros;
+    uint32_t maxMicros;
+    uint32_t buckets[NUM_BUCKETS];
+};
+
+/********************************** DECODER ***********************************/
+
+static uint8_t bucket(uint32_t duration) {
+
+  uint8_t bucket = 0;
+
+  for (duration >>= 4; duration != 0 && bucket < NUM_BUCKETS - 1; duration >>= 1) {
+    bucket++;
+  }
+
+  return bucket;
+}
+
+static void printHistogram(const DeviceTrace &device) {
+
+  uint32_t most = 0;
+
+  for (uint8_t i = 0; i < NUM_BUCKETS; i++) {
+    if (device.buckets[i] > most) {
+      most = device.buckets[i];
+    }
+  }
+
+  for (uint8_t i = 0; i < NUM_BUCKETS; i++) {
+    uint32_t bar = most ? (device.buckets[i] * BAR_WIDTH + most - 1) / most : 0;
+
+    if (i == 0) {
+      printf("      < %5u us  ", 16);
+    }
+    else if (i == NUM_BUCKETS - 1) {
+      printf("     >= %5u us  ", 16 << (i - 1));
+    }
+    else {
+      printf("  %5u-%5u us  ", 16 << (i - 1), (16 << i) - 1);
+    }
+
+    for (uint32_t j = 0; j < bar; j++) {
+      putchar('#');
+    }
+    printf(" %u\n", device.buckets[i]);
+  }
+}
+
+static int decode(const char *path) {
+
+  static DeviceTrace devices[NUM_ADDRESSES];
+  FILE *file = fopen(path, "r");
+  char line[128];
+  uint32_t entries = 0;
+  uint32_t first = 0;
+  uint32_t end = 0;
+
+  if (file == NULL) {
+    fprintf(stderr, "Cannot read %s\n", path);
+    return 2;
+  }
+
+  while (fgets(line, sizeof(line), file) != NULL) {
+    unsigned long start;
+    unsigned address, control, count, value, status, duration;
+    char rw;
+
+    if (sscanf(line, "%lu,%x,%c,%x,%u,%x,%u,%u", &start, &address, &rw, &control, &count, &value, &status, &duration) != 8
+        || address >= NUM_ADDRESSES) {
+      continue;
+    }
+
+    DeviceTrace &device = devices[address];
+
+    if (rw == 'r') {
+      device.reads++;
+    }
+    else {
+      device.writes++;
+    }
+
+    if (status != PCA9622_OK) {
+      device.errors++;
+    }
+
+    device.bytes += count + (rw == 'r' ? 1 : 2);
+    device.busMicros += duration;
+    device.buckets[bucket(duration)]++;
+
+    if (duration > device.maxMicros) {
+      device.maxMicros = duration;
+    }
+
+    // Time span of the dump, micros() wraps after 71 minutes
+    if (entries == 0) {
+      first = start;
+    }
+    if ((int32_t)(start + duration - end) > 0 || entries == 0) {
+      end = start + duration;
+    }
+    entries++;
+  }
+
+  fclose(file);
+
+  if (entries == 0) {
+    fprintf(stderr, "No trace entries in %s\n", path);
+    return 1;
+  }
+
+  uint32_t span = end - first;
+
+  printf("%u transfers in %.3f ms\n", entries, span / 1000.0);
+
+  for (uint8_t address = 0; address < NUM_ADDRESSES; address++) {
+    const DeviceTrace &device = devices[address];
+
+    if (device.writes + device.reads == 0) {
+      continue;
+    }
+
+    printf("\nDevice 0x%02X: %u writes, %u reads, %u errors, %u bytes\n", address, device.writes, device.reads,
+           device.errors, device.bytes);
+    printf("  Bus time %.3f ms (%.1f%% of the span), mean %.1f us, max %u us\n", device.busMicros / 1000.0,
+           span ? 100.0 * device.busMicros / span : 0.0, (double)device.busMicros / (device.writes + device.reads),
+           device.maxMicros);
+    printHistogram(device);
+  }
+
+  return 0;
+}
+
+/*********************************** DEMO *************************************/
+
+#if defined(PCA9622_TRACE)
+static int demo(const char *path, uint32_t frames) {
+
+  PCA9622Model model0(0x20);
+  PCA9622Model model1(0x21);
+  PCA9622 fixture(REG_PWM0, REG_PWM1, REG_PWM2);
+  PCA9622 panel;
+  PCA9622 missing;
+  PCA9622Snapshot snapshot;
+  FILE *file = fopen(path, "w");
+
+  if (file == NULL) {
+    fprintf(stderr, "Cannot write %s\n", path);
+    return 2;
+  }
+
+  Wire.attach(&model0);
+  Wire.attach(&model1);
+
+  fixture.begin(0x20, &Wire, PCA9622_CLOCK_FAST);
+  panel.begin(0x21, &Wire);
+  missing.begin(0x22, &Wire);
+  missing.setRetryPolicy(2, 100);
+
+  fixture.setLdrStateAll(LDR_STATE_IND);
+  panel.setLdrStateAll(LDR_STATE_IND);
+
+  PCA9622Trace::clear();
+
+  for (uint32_t frame = 0; frame < frames; frame++) {
+    uint8_t pwm[16];
+
+    // One transfer per channel on the fixture, one burst on the panel
+    fixture.setRGB(frame, 255 - frame, frame * 3);
+
+    for (uint8_t i = 0; i < 16; i++) {
+      pwm[i] = frame + 16 * i;
+    }
+    panel.setAllPwm(pwm);
+
+    if (frame % 10 == 0) {
+      panel.snapshot(snapshot);
+      missing.setGrpPwm(frame);
+    }
+
+    delay(10);
+  }
+
+  PCA9622Trace::dump(file);
+  fclose(file);
+
+  printf("%u frames, %u transfers traced\n", frames, PCA9622Trace::written());
+
+  return 0;
+}
+#endif
+
+int main(int argc, char **argv) {
+
+  if (argc >= 3 && strcmp(argv[1], "demo") == 0) {
+#if defined(PCA9622_TRACE)
+    uint32_t frames = (argc > 3) ? atol(argv[3]) : 50;
+
+    return demo(argv[2], frames);
+#else
+    fprintf(stderr, "Build with -DPCA9622_TRACE for the demo\n");
+    return 2;
+#endif
+  }
+
+  if (argc == 2) {
+    return decode(argv[1]);
+  }
+
+  fprintf(stderr, "Usage: %s <dump.txt>\n"
+                  "       %s demo <dump.txt> [frames]\n", argv[0], argv[0]);
+
+  return 2;
+}
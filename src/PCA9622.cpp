@@ -7,6 +7,7 @@
  */
 
 #include "PCA9622.h"
+#include "PCA9622Trace.h"
 
 /******************************* PUBLIC METHODS *******************************/
 
@@ -25,6 +26,62 @@ PCA9622::PCA9622(uint8_t regRedPwm, uint8_t regGreenPwm, uint8_t regBluePwm) {
   _regBluePwm = regBluePwm;
 
   _hasWhiteChannel = false;
+  _turnedOff = false;
+
+  // Power-up defaults until begin() reads the registers
+  memset(_reg, 0, PCA9622_NUM_REGS);
+  _reg[REG_MODE1] = (1 << BIT_SLEEP) | (1 << BIT_ALLCALL);
+  _reg[REG_MODE2] = 0x05;
+  _reg[REG_GRPPWM] = 0xFF;
+  _reg[REG_SUBADR1] = 0xE2;
+  _reg[REG_SUBADR2] = 0xE4;
+  _reg[REG_SUBADR3] = 0xE8;
+  _reg[REG_ALLCALLADR] = 0xE0;
+
+  _dirtyRegs = 0;
+  _deferred = false;
+
+  _retries = 0;
+  _retryBackoff = 0;
+  _lastError = PCA9622_OK;
+  resetStats();
+  _frameWasDeferred = false;
+
+  _autoSleepMillis = 0;
+  _idleSince = 0;
+  _idle = false;
+  _autoSlept = false;
+  _sleepStart = 0;
+  _chipAsleep = true;
+  _oscStarting = false;
+  _wakeMicros = 0;
+
+  _gammaTable = NULL;
+  _gammaChannels = 0;
+
+  _queue = NULL;
+  _queueSize = 0;
+  _queueHead = 0;
+  _queueUsed = 0;
+  _queueStalls = 0;
+  _queuedToken = 0;
+  _sentToken = 0;
+  _onComplete = NULL;
+
+  _sdaPin = PCA9622_NO_PIN;
+  _sclPin = PCA9622_NO_PIN;
+  _clock = 0;
+  _transferFailed = false;
+  _recoveryMicros = 0;
+}
+
+    /**
+     * Constructor for a PCA9622 shared by several fixtures, see
+     * PCA9622RGBView. setRGB() and setRGBW() use channels 0 to 3
+     */
+PCA9622::PCA9622()
+       : PCA9622(REG_PWM0, REG_PWM1, REG_PWM2, REG_PWM3) {
+
 }
 
     /**
@@ -49,16 +106,171 @@ PCA9622::PCA9622(uint8_t regRedPwm, uint8_t regGreenPwm, uint8_t regBluePwm, uin
      *
      * @param deviceAddress I2C address of the PCA9622
      * @param wire          Reference to TwoWire for I2C communication
+     * @param clock         Bus clock in Hz (see PCA9622_CLOCK_*), 0 to keep
+     *                      the clock of wire
+     *
+     * @return PCA9622_OK or PCA9622_ERR_* of reading back the registers. On
+     *         failure the register cache holds the power-up defaults
      */
-void PCA9622::begin(uint8_t deviceAddress, TwoWire *wire) {
+uint8_t PCA9622::begin(uint8_t deviceAddress, TwoWire *wire, uint32_t clock) {
 
   _deviceAddress = deviceAddress;
+  _clock = clock;
 
   _wire = wire;
   _wire->begin();
 
+  if (clock != 0) {
+    _wire->setClock(clock);
+  }
+
   writeReg(REG_MODE1, 0x0);
   writeReg(REG_MODE2, 0x0);
+
+  return resync();
+}
+
+    /**
+     * Take over a PCA9622 that is already running, e.g. after a reset of the
+     * microcontroller. Nothing is written, the register cache is loaded from
+     * the PCA9622 in a single read, so the outputs don't flash
+     *
+     * @param deviceAddress I2C address of the PCA9622
+     * @param wire          Reference to TwoWire for I2C communication
+     * @param clock         Bus clock in Hz (see PCA9622_CLOCK_*), 0 to keep
+     *                      the clock of wire
+     *
+     * @return PCA9622_OK or PCA9622_ERR_*
+     */
+uint8_t PCA9622::attach(uint8_t deviceAddress, TwoWire *wire, uint32_t clock) {
+
+  _deviceAddress = deviceAddress;
+  _clock = clock;
+
+  _wire = wire;
+  _wire->begin();
+
+  if (clock != 0) {
+    _wire->setClock(clock);
+  }
+
+  return resync();
+}
+
+    /**
+     * Reload the register cache from the PCA9622 in a single read. Only
+     * needed when the registers may have changed without the driver knowing
+     * (e.g. after a reset of the device or when another bus master wrote to
+     * it)
+     *
+     * @return PCA9622_OK or PCA9622_ERR_*. On failure the register cache is
+     *         unchanged
+     */
+uint8_t PCA9622::resync() {
+
+  PCA9622Snapshot image;
+  uint8_t status = snapshot(image);
+
+  if (status != PCA9622_OK) {
+    return status;
+  }
+
+  memcpy(_reg, image.reg, PCA9622_NUM_REGS);
+  _dirtyRegs = 0;
+  _chipAsleep = _reg[REG_MODE1] & (1 << BIT_SLEEP);
+
+  return status;
+}
+
+    /**
+     * Read consecutive registers from the PCA9622 in a single Auto-Increment
+     * transfer. The register address rolls over from REG_ALLCALLADR to
+     * REG_MODE1. The register cache is not changed
+     *
+     * @param registerAddress First register address to read
+     * @param data            Buffer for count bytes, unchanged on failure
+     * @param count           Number of registers, at most PCA9622_NUM_REGS
+     *
+     * @return PCA9622_OK or PCA9622_ERR_*
+     */
+uint8_t PCA9622::readRegs(uint8_t registerAddress, uint8_t *data, uint8_t count) {
+
+  uint8_t status;
+  uint8_t attempt = 0;
+
+  if (count > PCA9622_NUM_REGS) {
+    return PCA9622_ERR_TOO_LONG;
+  }
+
+  wait(_queuedToken);
+
+  do {
+    uint32_t start = micros();
+
+    _wire->beginTransmission(_deviceAddress);
+    _wire->write((AI_ALL << BIT_CTRL_AI) | (registerAddress & MASK_CTRL_REG));
+    status = _wire->endTransmission(false); // Repeated START, one transaction
+
+    recordTransfer(status, 2, micros() - start);
+    PCA9622_TRACE_TRANSFER(start, _deviceAddress, (AI_ALL << BIT_CTRL_AI) | (registerAddress & MASK_CTRL_REG), 0, 0, status);
+
+    if (status == PCA9622_OK) {
+      start = micros();
+
+      if (_wire->requestFrom(_deviceAddress, count) == count && _wire->available() == count) {
+        for (uint8_t i = 0; i < count; i++) {
+          data[i] = _wire->read();
+        }
+      }
+      else {
+        status = PCA9622_ERR_READ;
+      }
+
+      recordTransfer(status, count + 1, micros() - start);
+      PCA9622_TRACE_TRANSFER(start, _deviceAddress | TRACE_READ, (AI_ALL << BIT_CTRL_AI) | (registerAddress & MASK_CTRL_REG),
+                             status == PCA9622_OK && count > 0 ? data[0] : 0, count, status);
+    }
+  } while (status != PCA9622_OK && retryAfter(attempt++));
+
+  _lastError = status;
+
+  if (status != PCA9622_OK) {
+    _stats.errors++;
+    _transferFailed = true;
+  }
+
+  return status;
+}
+
+    /**
+     * Read the whole register file of the PCA9622 in a single transfer
+     *
+     * @param snapshot Snapshot to fill, unchanged on failure
+     *
+     * @return PCA9622_OK or PCA9622_ERR_*
+     */
+uint8_t PCA9622::snapshot(PCA9622Snapshot &snapshot) {
+
+  PCA9622Snapshot image;
+  uint8_t status = readRegs(REG_MODE1, image.reg, PCA9622_NUM_REGS);
+
+  if (status == PCA9622_OK) {
+    snapshot = image;
+  }
+
+  return status;
+}
+
+    /**
+     * Write a snapshot back to the PCA9622 in a single Auto-Increment
+     * transfer and take it over into the register cache. In deferred mode
+     * only the registers that differ are staged
+     *
+     * @param snapshot Snapshot taken with snapshot()
+     */
+void PCA9622::restore(const PCA9622Snapshot &snapshot) {
+
+  writeRegs(AI_ALL, REG_MODE1, snapshot.reg, PCA9622_NUM_REGS);
 }
 
     /**
@@ -66,10 +278,9 @@ void PCA9622::begin(uint8_t deviceAddress, TwoWire *wire) {
      */
 void PCA9622::sleep() {
 
-  uint8_t prevReg = readReg(REG_MODE1);
-  uint8_t newReg = prevReg | (1 << BIT_SLEEP);
-
-  writeReg(REG_MODE1, newReg);
+  if (countSleep(true)) {
+    writeReg(REG_MODE1, _reg[REG_MODE1] | (1 << BIT_SLEEP));
+  }
 }
 
     /**
@@ -77,43 +288,66 @@ void PCA9622::sleep() {
      */
 void PCA9622::wakeUp() {
 
-  uint8_t prevReg = readReg(REG_MODE1);
-  uint8_t newReg = prevReg & ~(1 << BIT_SLEEP);
+  if (countSleep(false)) {
+    writeReg(REG_MODE1, _reg[REG_MODE1] & ~(1 << BIT_SLEEP));
+  }
+}
 
-  writeReg(REG_MODE1, newReg);
+    /**
+     * Turn on all LEDs. Restores the LED driver output states saved at
+     * turnOff() in a single transfer. Does nothing if the LEDs were not
+     * turned off
+     */
+void PCA9622::turnOn() {
+
+  if (!_turnedOff) {
+    return;
+  }
+
+  _turnedOff = false;
+  writeRegs(AI_ALL, REG_LEDOUT0, _storedRegLedout, 4);
+}
+
+    /**
+     * Turn off all LEDs in a single transfer. Saves the LED driver output
+     * states for turnOn(). Calling turnOff() again keeps the saved states
+     * unless LEDs were turned on in between. For power saving, see sleep()
+     */
+void PCA9622::turnOff() {
+
+  const uint8_t ledout[4] = { LDR_STATE_OFF, LDR_STATE_OFF, LDR_STATE_OFF, LDR_STATE_OFF };
+
+  saveLedout();
+  writeRegs(AI_ALL, REG_LEDOUT0, ledout, 4);
 }
 
     /**
-     * Turn on all LEDs. Restores settings saved at turnOff()
+     * Save the current output image (see PCA9622Scene) from the register
+     * cache
      *
-     * WARNING: If you call turnOff() twice without calling turnOn() in between,
-     *          then the restored state will be LDR_STATE_OFF!
+     * @param scene Scene to fill
      */
-void PCA9622::turnOn() {
+void PCA9622::saveScene(PCA9622Scene &scene) {
 
-  writeReg(REG_LEDOUT0, _storedRegLedout0);
-  writeReg(REG_LEDOUT1, _storedRegLedout1);
-  writeReg(REG_LEDOUT2, _storedRegLedout2);
-  writeReg(REG_LEDOUT3, _storedRegLedout3);
+  memcpy(scene.reg, &_reg[PCA9622_SCENE_FIRST_REG], PCA9622_SCENE_SIZE);
 }
 
     /**
-     * Turn off all LEDs. Saves current settings for turnOn()
-     * For power saving, see sleep()
+     * Switch to a scene. Only registers that differ from the current state
+     * are sent, in as few Auto-Increment transfers as flush() needs. In
+     * deferred mode the changes are only staged
      *
-     * WARNING: If you call turnOff() twice without calling turnOn() in between,
-     *          then the restored state will be LDR_STATE_OFF!
+     * @param scene Scene to apply
      */
-void PCA9622::turnOff() {
+void PCA9622::applyScene(const PCA9622Scene &scene) {
 
-  _storedRegLedout0 = readReg(REG_LEDOUT0);
-  writeReg(REG_LEDOUT0, LDR_STATE_OFF);
-  _storedRegLedout1 = readReg(REG_LEDOUT1);
-  writeReg(REG_LEDOUT1, LDR_STATE_OFF);
-  _storedRegLedout2 = readReg(REG_LEDOUT2);
-  writeReg(REG_LEDOUT2, LDR_STATE_OFF);
-  _storedRegLedout3 = readReg(REG_LEDOUT3);
-  writeReg(REG_LEDOUT3, LDR_STATE_OFF);
+  for (uint8_t i = 0; i < PCA9622_SCENE_SIZE; i++) {
+    stageReg(PCA9622_SCENE_FIRST_REG + i, scene.reg[i]);
+  }
+
+  if (!_deferred) {
+    flush();
+  }
 }
 
     /**
@@ -124,7 +358,45 @@ void PCA9622::turnOff() {
      */
 void PCA9622::setPwm(uint8_t regPwm, uint8_t pwm) {
 
-  writeReg(regPwm, pwm);
+  writeReg(regPwm, correct(regPwm, pwm));
+}
+
+    /**
+     * Get the individual PWM value last set for a given channel. Taken from
+     * the register cache, nothing is read from the device. With a brightness
+     * table, the value is mapped back through the table, so setPwm() with it
+     * keeps the output unchanged
+     *
+     * @param regPwm Register address for PWM channel
+     *
+     * @return PWM value, before brightness correction
+     */
+uint8_t PCA9622::getPwm(uint8_t regPwm) {
+
+  if (regPwm >= PCA9622_NUM_REGS) {
+    return 0;
+  }
+
+  if (!isCorrected(regPwm)) {
+    return _reg[regPwm];
+  }
+
+  // Smallest value the table maps to the register content or above. The table is monotonic
+  uint8_t low = 0;
+  uint8_t high = 0xFF;
+
+  while (low < high) {
+    uint8_t mid = low + (high - low) / 2;
+
+    if (PCA9622_GAMMA_READ(_gammaTable, mid) < _reg[regPwm]) {
+      low = mid + 1;
+    }
+    else {
+      high = mid;
+    }
+  }
+
+  return low;
 }
 
     /**
@@ -137,6 +409,88 @@ void PCA9622::setGrpPwm(uint8_t pwm) {
   writeReg(REG_GRPPWM, pwm);
 }
 
+    /**
+     * Set individual PWM values for all 16 channels in a single
+     * Auto-Increment transfer
+     *
+     * @param pwm Array of 16 PWM values, starting with channel 0
+     */
+void PCA9622::setAllPwm(const uint8_t pwm[16]) {
+
+  setPwmRange(REG_PWM0, 16, pwm);
+}
+
+    /**
+     * Set individual PWM values for consecutive channels in a single
+     * Auto-Increment transfer (AI_IND). After REG_PWM15 the transfer rolls
+     * over to REG_PWM0. The Auto-Increment option set with
+     * setAutoIncrement() is not changed
+     *
+     * @param regPwm Register address of the first PWM channel
+     * @param count  Number of channels to write (at most 16)
+     * @param pwm    PWM values
+     */
+void PCA9622::setPwmRange(uint8_t regPwm, uint8_t count, const uint8_t *pwm) {
+
+  if (regPwm < REG_PWM0 || regPwm > REG_PWM15 || count == 0) {
+    return;
+  }
+
+  if (count > 16) {
+    count = 16;
+  }
+
+  if (_gammaTable == NULL) {
+    writeRegs(AI_IND, regPwm, pwm, count);
+    return;
+  }
+
+  uint8_t corrected[16];
+  uint8_t reg = regPwm;
+
+  for (uint8_t i = 0; i < count; i++) {
+    corrected[i] = correct(reg, pwm[i]);
+    reg = nextReg(AI_IND, reg);
+  }
+
+  writeRegs(AI_IND, regPwm, corrected, count);
+}
+
+    /**
+     * Apply a brightness correction table to the color channels of this
+     * fixture (red, green, blue and, for RGBW, white). All individual PWM
+     * values are looked up in the table before they are written, including
+     * setAllPwm() and setPwmRange()
+     *
+     * @param table Table of 256 entries in flash (see PCA9622GammaTable),
+     *              or NULL to write PWM values unchanged
+     */
+void PCA9622::setGammaTable(const uint8_t *table) {
+
+  uint16_t channelMask = (1 << (_regRedPwm - REG_PWM0))
+                       | (1 << (_regGreenPwm - REG_PWM0))
+                       | (1 << (_regBluePwm - REG_PWM0));
+
+  if (_hasWhiteChannel) {
+    channelMask |= (1 << (_regWhitePwm - REG_PWM0));
+  }
+
+  setGammaTable(table, channelMask);
+}
+
+    /**
+     * Apply a brightness correction table to a set of channels
+     *
+     * @param table       Table of 256 entries in flash (see PCA9622GammaTable),
+     *                    or NULL to write PWM values unchanged
+     * @param channelMask Bit n set to correct channel n (REG_PWM0 + n)
+     */
+void PCA9622::setGammaTable(const uint8_t *table, uint16_t channelMask) {
+
+  _gammaTable = table;
+  _gammaChannels = channelMask;
+}
+
     /**
      * Set up values for blinking mode. Blinking mode needs to be activated
      * manually by calling setGroupControlMode(GROUP_CONTROL_MODE_BLINKING)
@@ -148,17 +502,83 @@ void PCA9622::setGrpPwm(uint8_t pwm) {
      */
 void PCA9622::setBlinking(uint8_t blinkPeriod, float onOffRatio) {
 
-  int16_t ratio = onOffRatio * 256;
+  setBlinkingPermille(blinkPeriod, permille(onOffRatio));
+}
+
+    /**
+     * Set up values for blinking mode with integer math, see setBlinking()
+     *
+     * @param blinkPeriod   Period for one blink (turning off and on)
+     * @param onOffPermille Time the LEDs are on in 1/1000 of the period,
+     *                      0 to 1000
+     */
+void PCA9622::setBlinkingPermille(uint8_t blinkPeriod, uint16_t onOffPermille) {
+
+  uint8_t data[2] = { blinkRatio(onOffPermille), blinkPeriod };
+
+  writeRegs(AI_GBL, REG_GRPPWM, data, 2);
+}
+
+    /**
+     * Set up values for blinking mode from a period and on time in
+     * milliseconds. Both registers are sent in a single transfer. Blinking
+     * mode needs to be activated manually by calling
+     * setGroupControlMode(GROUP_CONTROL_MODE_BLINKING)
+     *
+     * @param periodMs Period for one blink, BLINKING_PERIOD_MIN_MS to
+     *                 BLINKING_PERIOD_MAX_MS
+     * @param onTimeMs Time the LEDs are on during one period
+     *
+     * @return false if the period can't be set in hardware, nothing is
+     *         written then
+     */
+bool PCA9622::setBlinkingMs(uint16_t periodMs, uint16_t onTimeMs) {
+
+  uint8_t data[2];
 
-  if (ratio < 0) {
-    ratio = 0;
+  if (!blinkingRegs(periodMs, onTimeMs, &data[1], &data[0])) {
+    return false;
   }
-  else if (ratio > 255) {
-    ratio = 255;
+
+  writeRegs(AI_GBL, REG_GRPPWM, data, 2);
+
+  return true;
+}
+
+    /**
+     * Compute the GRPFREQ and GRPPWM values for blinking with integer math
+     *
+     * @param periodMs Period for one blink in milliseconds
+     * @param onTimeMs Time the LEDs are on during one period in milliseconds
+     * @param grpFreq  GRPFREQ value
+     * @param grpPwm   GRPPWM value
+     *
+     * @return false if the period is outside BLINKING_PERIOD_MIN_MS to
+     *         BLINKING_PERIOD_MAX_MS
+     */
+bool PCA9622::blinkingRegs(uint16_t periodMs, uint16_t onTimeMs, uint8_t *grpFreq, uint8_t *grpPwm) {
+
+  if (periodMs < BLINKING_PERIOD_MIN_MS || periodMs > BLINKING_PERIOD_MAX_MS) {
+    return false;
+  }
+
+  // Period = (GRPFREQ + 1) / 24Hz, rounded to the nearest step
+  uint16_t steps = ((uint32_t) periodMs * 24 + 500) / 1000;
+
+  // Duty cycle = GRPPWM / 256
+  uint32_t duty = ((uint32_t) onTimeMs * 256 + periodMs / 2) / periodMs;
+
+  if (duty > 255) {
+    duty = 255;
   }
+  else if (duty == 0 && onTimeMs > 0) {
+    duty = 1;
+  }
+
+  *grpFreq = steps - 1;
+  *grpPwm = duty;
 
-  writeReg(REG_GRPFREQ, blinkPeriod);
-  writeReg(REG_GRPPWM, (uint8_t) ratio);
+  return true;
 }
 
     /**
@@ -205,7 +625,7 @@ void PCA9622::setRGBW(uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
     */
 void PCA9622::setLdrState(uint8_t state, uint8_t regLedout, uint8_t ldrBit) {
 
-  uint8_t prevReg = readReg(regLedout);
+  uint8_t prevReg = _reg[regLedout];
   uint8_t newReg;
 
   newReg = prevReg & ~(0b11 << ldrBit);
@@ -254,6 +674,44 @@ void PCA9622::setLdrStateAll(uint8_t state) {
   writeReg(REG_LEDOUT3, newReg);
 }
 
+    /**
+    * Set the LED driver output state for a set of channels. Only LEDOUT
+    * registers that change are written, in a single transfer
+    *
+    * @param channelMask Bit n set for channel n (REG_PWM0 + n)
+    * @param state       One of the four possible states (see LDR_STATE_*)
+    */
+void PCA9622::setLdrStates(uint16_t channelMask, uint8_t state) {
+
+  uint8_t newRegs[4];
+  int8_t first = -1;
+  int8_t last = -1;
+
+  for (uint8_t i = 0; i < 4; i++) {
+    newRegs[i] = _reg[REG_LEDOUT0 + i];
+
+    for (uint8_t ldr = 0; ldr < 4; ldr++) {
+      if (channelMask & (1 << (4 * i + ldr))) {
+        newRegs[i] &= ~(0b11 << (2 * ldr));
+        newRegs[i] |= (state << (2 * ldr));
+      }
+    }
+
+    if (newRegs[i] != _reg[REG_LEDOUT0 + i]) {
+      if (first < 0) {
+        first = i;
+      }
+      last = i;
+    }
+  }
+
+  if (first < 0) {
+    return;
+  }
+
+  writeRegs(AI_ALL, REG_LEDOUT0 + first, &newRegs[first], last - first + 1);
+}
+
     /**
     * Set an option for auto increment. There are five options:
     *   - AI_DISABLED
@@ -313,7 +771,7 @@ void PCA9622::setAutoIncrement(uint8_t option) {
     */
 void PCA9622::setGroupControlMode(uint8_t mode) {
 
-  uint8_t prevReg = readReg(REG_MODE2);
+  uint8_t prevReg = _reg[REG_MODE2];
 
   switch (mode) {
     case GROUP_CONTROL_MODE_BLINKING:
@@ -327,42 +785,1007 @@ void PCA9622::setGroupControlMode(uint8_t mode) {
   }
 }
 
-/****************************** PRIVATE METHODS *******************************/
+    /**
+    * Set when the outputs follow written registers. There are two options:
+    *   - OUTPUT_CHANGE_ON_STOP
+    *   - OUTPUT_CHANGE_ON_ACK
+    *
+    * @param option One of the two possible options
+    */
+void PCA9622::setOutputChange(uint8_t option) {
+
+  uint8_t prevReg = _reg[REG_MODE2];
 
+  switch (option) {
+    case OUTPUT_CHANGE_ON_ACK:
+      writeReg(REG_MODE2, prevReg | (1 << BIT_OCH));
+      break;
+
+    case OUTPUT_CHANGE_ON_STOP:
+    default:
+      writeReg(REG_MODE2, prevReg & ~(1 << BIT_OCH));
+      break;
+  }
+}
+
+    /**
+    * Start a frame. Until commitFrame(), all setters only update the
+    * register cache (see setDeferred())
+    */
+void PCA9622::beginFrame() {
+
+  _frameWasDeferred = _deferred;
+  _deferred = true;
+}
+
+    /**
+    * Send all changes since beginFrame() so they become visible at the
+    * same time. Outputs are switched to change on STOP, and all changed
+    * PWM, GRPPWM, GRPFREQ and LEDOUT registers are sent in a single
+    * Auto-Increment transfer, so they are applied together by its STOP
+    */
+void PCA9622::commitFrame() {
+
+  setOutputChange(OUTPUT_CHANGE_ON_STOP);
+  commit();
+
+  _deferred = _frameWasDeferred;
+}
+
+    /**
+    * Send all staged changes, e.g. of fixture views (see PCA9622RGBView).
+    * Changed PWM, GRPPWM, GRPFREQ and LEDOUT registers are sent in a single
+    * Auto-Increment transfer, after all other changed registers
+    */
+void PCA9622::commit() {
+
+  const uint32_t outputRegs = ((1UL << (REG_LEDOUT3 + 1)) - 1) & ~((1UL << REG_PWM0) - 1);
+
+  // Everything else (e.g. MODE2) goes first, in its own transfers
+  uint32_t frameRegs = _dirtyRegs & outputRegs;
+
+  _dirtyRegs &= ~outputRegs;
+  flushDirty();
+
+  if (frameRegs != 0) {
+    uint8_t first = REG_PWM0;
+    uint8_t last = REG_LEDOUT3;
+
+    while (!(frameRegs & (1UL << first))) {
+      first++;
+    }
+
+    while (!(frameRegs & (1UL << last))) {
+      last--;
+    }
+
+    transmit(AI_ALL, first, &_reg[first], last - first + 1);
+  }
+
+  autoWake();
+}
 
     /**
-    * Write data to a register
+    * Enable or disable deferred writes. While enabled, all setters only
+    * update the register cache and mark changed registers as dirty. Nothing
+    * is sent to the PCA9622 until flush() is called. Disabling deferred
+    * writes flushes pending changes
     *
-    * @param registerAddress Register address to write to
-    * @param data            Data to write
+    * @param deferred true to defer writes until flush()
     */
-void PCA9622::writeReg(uint8_t registerAddress, uint8_t data) {
+void PCA9622::setDeferred(bool deferred) {
+
+  _deferred = deferred;
+
+  if (!deferred) {
+    flush();
+  }
+}
+
+    /**
+    * @return true if writes are deferred until flush()
+    */
+bool PCA9622::isDeferred() {
+
+  return _deferred;
+}
+
+    /**
+    * Send all registers changed since the last flush() to the PCA9622.
+    * Registers written with their current value are skipped. Dirty
+    * registers are merged into as few Auto-Increment transfers as possible;
+    * gaps of up to PCA9622_FLUSH_MAX_GAP unchanged registers are sent along
+    * when that is cheaper than starting a new transfer
+    */
+void PCA9622::flush() {
 
-  _wire->beginTransmission(_deviceAddress);
-  _wire->write(registerAddress);
-  _wire->write(data);
-  _wire->endTransmission();
+  flushDirty();
+  autoWake();
 }
 
     /**
-    * Read data from a register
+    * Enable asynchronous writes. All writes are appended to a queue in the
+    * given buffer and sent by poll(), so setters return without waiting for
+    * the bus. Each queued transfer takes its data size plus 2 bytes. When the
+    * queue is full, a write waits for room by calling poll() itself (see
+    * queueStalls()). Reads always wait for the queue to drain first
     *
-    * @param registerAddress Register address to read from
-     *
-     * @return byte read from given registerAddress
-     * @return -1 if no byte was available to be read
+    * @param buffer Memory for the queue. Must stay valid until endQueue()
+    * @param size   Size of buffer in bytes
+    */
+void PCA9622::beginQueue(uint8_t *buffer, uint16_t size) {
+
+  endQueue();
+
+  _queue = buffer;
+  _queueSize = size;
+  _queueHead = 0;
+  _queueUsed = 0;
+  _queueStalls = 0;
+}
+
+    /**
+    * Send all queued transfers and switch back to synchronous writes
+    */
+void PCA9622::endQueue() {
+
+  wait(_queuedToken);
+
+  _queue = NULL;
+  _queueSize = 0;
+}
+
+    /**
+    * Send the oldest queued transfer, if any. Call this regularly from the
+    * main loop or from a timer when asynchronous writes are enabled
+    *
+    * @return true if more transfers are queued
     */
-uint8_t PCA9622::readReg(uint8_t registerAddress) {
+bool PCA9622::poll() {
 
-  _wire->beginTransmission(_deviceAddress);
-  _wire->write(registerAddress);
-  _wire->endTransmission();
+  if (_queueUsed == 0) {
+    return false;
+  }
 
-  _wire->requestFrom(_deviceAddress, (uint8_t) 1);
+  uint8_t data[PCA9622_NUM_REGS];
+  uint8_t control = _queue[_queueHead];
+  uint8_t count = _queue[(_queueHead + 1) % _queueSize];
 
-  if (_wire->available() == 1) {
-    return _wire->read();
+  for (uint8_t i = 0; i < count; i++) {
+    data[i] = _queue[(_queueHead + 2 + i) % _queueSize];
   }
 
-  return -1;
+  sendTransfer(control, data, count);
+
+  _queueHead = (_queueHead + 2 + count) % _queueSize;
+  _queueUsed -= 2 + count;
+  _sentToken++;
+
+  if (_onComplete != NULL) {
+    _onComplete(_sentToken);
+  }
+
+  return _queueUsed > 0;
+}
+
+    /**
+    * Token of the most recently queued transfer, to be used with
+    * isComplete() and wait()
+    *
+    * @return completion token
+    */
+uint16_t PCA9622::lastToken() {
+
+  return _queuedToken;
+}
+
+    /**
+    * Check whether a queued transfer was sent
+    *
+    * @param token Completion token from lastToken()
+    *
+    * @return true if the transfer and all transfers queued before it were sent
+    */
+bool PCA9622::isComplete(uint16_t token) {
+
+  return (int16_t) (_sentToken - token) >= 0;
+}
+
+    /**
+    * Send queued transfers until the given one was sent
+    *
+    * @param token Completion token from lastToken()
+    */
+void PCA9622::wait(uint16_t token) {
+
+  while (!isComplete(token) && poll()) {
+  }
+}
+
+    /**
+    * Free space in the queue
+    *
+    * @return free bytes, a transfer needs its data size plus 2 bytes
+    */
+uint16_t PCA9622::queueFree() {
+
+  return _queueSize - _queueUsed;
+}
+
+    /**
+    * Number of writes that had to wait for room in the queue since
+    * beginQueue(). A growing number means poll() is not called often enough
+    *
+    * @return number of stalled writes
+    */
+uint16_t PCA9622::queueStalls() {
+
+  return _queueStalls;
+}
+
+    /**
+    * Register a function that is called after each queued transfer was sent
+    *
+    * @param callback Function receiving the completion token, or NULL
+    */
+void PCA9622::onComplete(void (*callback)(uint16_t token)) {
+
+  _onComplete = callback;
+}
+
+    /**
+    * Set how failed transfers are repeated. Between attempts, the driver
+    * waits backoffMicros, doubling the wait after each attempt. Registers of
+    * a write that failed after all retries stay dirty and are sent again by
+    * the next flush()
+    *
+    * @param retries       Number of repetitions, at most PCA9622_MAX_RETRIES
+    * @param backoffMicros Wait before the first repetition in microseconds
+    */
+void PCA9622::setRetryPolicy(uint8_t retries, uint16_t backoffMicros) {
+
+  _retries = (retries > PCA9622_MAX_RETRIES) ? PCA9622_MAX_RETRIES : retries;
+  _retryBackoff = backoffMicros;
+}
+
+    /**
+    * Status of the last transfer (see PCA9622_OK and PCA9622_ERR_*)
+    *
+    * @return status
+    */
+uint8_t PCA9622::getLastError() {
+
+  return _lastError;
+}
+
+    /**
+    * Bus statistics since begin() or resetStats()
+    *
+    * @return statistics
+    */
+const PCA9622Stats &PCA9622::getStats() {
+
+  if (_reg[REG_MODE1] & (1 << BIT_SLEEP)) {
+    uint32_t now = millis();
+
+    _stats.sleepMillis += now - _sleepStart;
+    _sleepStart = now;
+  }
+
+  return _stats;
+}
+
+    /**
+    * Clear the bus statistics
+    */
+void PCA9622::resetStats() {
+
+  memset(&_stats, 0, sizeof(_stats));
+  _sleepStart = millis();
+}
+
+    /**
+    * Put the PCA9622 to sleep automatically while all outputs are off (all
+    * LDR_STATE_OFF, or individual PWM 0). After idleMillis without output,
+    * updatePower() switches to low-power mode. The next write that turns an
+    * output on wakes the PCA9622 again, once, after its data was sent
+    *
+    * @param idleMillis Idle time before sleeping, 0 to disable
+    */
+void PCA9622::setAutoSleep(uint32_t idleMillis) {
+
+  _autoSleepMillis = idleMillis;
+  _idle = false;
+
+  if (idleMillis == 0 && _autoSlept) {
+    wakeUp();
+  }
+}
+
+    /**
+    * Switch to low-power mode if the automatic sleep time has elapsed. Call
+    * this regularly from the main loop, see setAutoSleep()
+    */
+void PCA9622::updatePower() {
+
+  // Never sleep with changes pending, their flush decides
+  if (_autoSleepMillis == 0 || _deferred || _dirtyRegs != 0 || (_reg[REG_MODE1] & (1 << BIT_SLEEP))) {
+    return;
+  }
+
+  if (!outputsOff()) {
+    _idle = false;
+    return;
+  }
+
+  if (!_idle) {
+    _idle = true;
+    _idleSince = millis();
+  }
+
+  if (millis() - _idleSince >= _autoSleepMillis) {
+    sleep();
+    _autoSlept = true;
+  }
+}
+
+    /**
+    * @return true if no output is on according to the register cache
+    */
+bool PCA9622::outputsOff() {
+
+  for (uint8_t channel = 0; channel < 16; channel++) {
+    uint8_t state = (_reg[REG_LEDOUT0 + channel / 4] >> (2 * (channel % 4))) & 0b11;
+
+    if (state == LDR_STATE_ON || (state != LDR_STATE_OFF && _reg[REG_PWM0 + channel] != 0)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+    /**
+    * Set the pins of the bus lines, for the bus clear in recover(). Without
+    * them, recover() only writes the register image
+    *
+    * @param sdaPin Pin number of SDA
+    * @param sclPin Pin number of SCL
+    */
+void PCA9622::setBusPins(uint8_t sdaPin, uint8_t sclPin) {
+
+  _sdaPin = sdaPin;
+  _sclPin = sclPin;
+}
+
+    /**
+    * Check that the PCA9622 still holds the register image of the driver,
+    * and recover() if not. A transfer that failed since the last check, a
+    * stuck bus or a PCA9622 back at its power-up defaults after a reset
+    * trigger the recovery. Costs a two-byte read while all is well. Call
+    * this regularly from the main loop
+    *
+    * @return PCA9622_OK if healthy or recovered, otherwise PCA9622_ERR_*
+    */
+uint8_t PCA9622::checkHealth() {
+
+  bool stuck = _sdaPin != PCA9622_NO_PIN && digitalRead(_sdaPin) == LOW;
+
+  if (!_transferFailed && !stuck) {
+    uint8_t mode[2];
+
+    // After a reset, MODE1 and MODE2 are back at their defaults (asleep, outputs change on STOP)
+    if (readRegs(REG_MODE1, mode, 2) == PCA9622_OK
+        && ((mode[0] ^ _reg[REG_MODE1]) & ~MASK_MODE1_AI) == 0 && mode[1] == _reg[REG_MODE2]) {
+      return PCA9622_OK;
+    }
+  }
+
+  return recover();
+}
+
+    /**
+    * Recover after a bus glitch or a reset of the PCA9622. A stuck bus is
+    * freed with the bus clear sequence if the bus pins are set, then the
+    * whole register cache is written, the registers after MODE1 once the
+    * oscillator runs. Queued transfers are dropped, their data is part of
+    * the register cache. Registers staged in deferred mode are written as
+    * well and stay dirty for the next flush
+    *
+    * @return PCA9622_OK or PCA9622_ERR_*
+    */
+uint8_t PCA9622::recover() {
+
+  uint32_t start = micros();
+
+  _queueHead = 0;
+  _queueUsed = 0;
+  _sentToken = _queuedToken;
+
+  if (_sclPin != PCA9622_NO_PIN
+      && (digitalRead(_sdaPin) == LOW || _lastError == PCA9622_ERR_OTHER || _lastError == PCA9622_ERR_TIMEOUT)) {
+    clearBus();
+  }
+
+  // Registers staged in deferred mode are part of the image, but stay dirty for the next flush
+  uint32_t staged = _deferred ? _dirtyRegs : 0;
+
+  // The state of SLEEP is unknown, the transfer restarts the oscillator guard
+  _chipAsleep = true;
+  _oscStarting = false;
+
+  uint8_t status = sendTransfer((AI_ALL << BIT_CTRL_AI) | REG_MODE1, _reg, PCA9622_NUM_REGS);
+
+  if (status == PCA9622_OK) {
+    _dirtyRegs = staged;
+    _transferFailed = false;
+    _recoveryMicros = micros() - start;
+    _stats.recoveries++;
+    _stats.recoveryMicros += _recoveryMicros;
+  }
+
+  return status;
+}
+
+    /**
+    * @return duration of the last successful recover() in microseconds,
+    *         including the bus clear
+    */
+uint32_t PCA9622::lastRecoveryMicros() {
+
+  return _recoveryMicros;
+}
+
+/****************************** PRIVATE METHODS *******************************/
+
+
+    /**
+    * Write data to a register and update the register cache
+    *
+    * @param registerAddress Register address to write to
+    * @param data            Data to write
+    */
+void PCA9622::writeReg(uint8_t registerAddress, uint8_t data) {
+
+  if (_deferred) {
+    stageReg(registerAddress, data);
+    return;
+  }
+
+  cacheRegs(AI_DISABLED, registerAddress, &data, 1);
+  transmit(AI_DISABLED, registerAddress, &data, 1);
+  autoWake();
+}
+
+    /**
+    * Write data to consecutive registers in one transfer and update the
+    * register cache. The register address follows the rollover rules of the
+    * given Auto-Increment option
+    *
+    * @param option          Auto-Increment option for this transfer (see AI_*)
+    * @param registerAddress First register address to write to
+    * @param data            Data to write
+    * @param count           Number of bytes to write
+    */
+void PCA9622::writeRegs(uint8_t option, uint8_t registerAddress, const uint8_t *data, uint8_t count) {
+
+  if (_deferred) {
+    for (uint8_t i = 0; i < count; i++) {
+      stageReg(registerAddress, data[i]);
+      registerAddress = nextReg(option, registerAddress);
+    }
+    return;
+  }
+
+  cacheRegs(option, registerAddress, data, count);
+  transmit(option, registerAddress, data, count);
+  autoWake();
+}
+
+    /**
+    * Update consecutive registers in the register cache and clear their
+    * dirty bits, e.g. after a transfer to a group address
+    *
+    * @param option          Auto-Increment option of the transfer (see AI_*)
+    * @param registerAddress First register address written
+    * @param data            Data written
+    * @param count           Number of bytes written
+    */
+void PCA9622::cacheRegs(uint8_t option, uint8_t registerAddress, const uint8_t *data, uint8_t count) {
+
+  // The MODE1 AIn bits are not cached, the option only applies to this transfer
+  for (uint8_t i = 0; i < count; i++) {
+    if (registerAddress < PCA9622_NUM_REGS) {
+      _reg[registerAddress] = data[i];
+      _dirtyRegs &= ~(1UL << registerAddress);
+    }
+    registerAddress = nextReg(option, registerAddress);
+  }
+}
+
+    /**
+    * Update a register in the register cache and mark it dirty if changed
+    *
+    * @param registerAddress Register address to update
+    * @param data            New register content
+    */
+void PCA9622::stageReg(uint8_t registerAddress, uint8_t data) {
+
+  if (registerAddress < PCA9622_NUM_REGS && _reg[registerAddress] != data) {
+    _reg[registerAddress] = data;
+    _dirtyRegs |= (1UL << registerAddress);
+  }
+}
+
+    /**
+    * Send data to consecutive registers in one transfer, or queue it when
+    * asynchronous writes are enabled. Does not touch the register cache
+    *
+    * @param option          Auto-Increment option for this transfer (see AI_*)
+    * @param registerAddress First register address to write to
+    * @param data            Data to write
+    * @param count           Number of bytes to write
+    */
+void PCA9622::transmit(uint8_t option, uint8_t registerAddress, const uint8_t *data, uint8_t count) {
+
+  uint8_t control = (option << BIT_CTRL_AI) | (registerAddress & MASK_CTRL_REG);
+
+  if (_queue == NULL || count + 2 > _queueSize) {
+    wait(_queuedToken);
+    sendTransfer(control, data, count);
+    return;
+  }
+
+  if (count + 2 > queueFree()) {
+    _queueStalls++;
+
+    while (count + 2 > queueFree()) {
+      poll();
+    }
+  }
+
+  uint16_t tail = (_queueHead + _queueUsed) % _queueSize;
+
+  _queue[tail] = control;
+  _queue[(tail + 1) % _queueSize] = count;
+
+  for (uint8_t i = 0; i < count; i++) {
+    _queue[(tail + 2 + i) % _queueSize] = data[i];
+  }
+
+  _queueUsed += 2 + count;
+  _queuedToken++;
+}
+
+    /**
+    * Send one transfer on the bus, repeated according to the retry policy.
+    * A transfer in which MODE1 clears SLEEP is split after MODE1. On failure,
+    * the registers written are marked dirty
+    *
+    * @param control Control byte with Auto-Increment option and register address
+    * @param data    Data to write
+    * @param count   Number of bytes to write
+    *
+    * @return PCA9622_OK or PCA9622_ERR_*
+    */
+uint8_t PCA9622::sendTransfer(uint8_t control, const uint8_t *data, uint8_t count) {
+
+  uint8_t option = control >> BIT_CTRL_AI;
+  uint8_t reg = control & MASK_CTRL_REG;
+
+  // A MODE1 byte that clears SLEEP ends the transfer, so the registers after
+  // it go through the oscillator guard
+  for (uint8_t i = 0; _chipAsleep && i + 1 < count; i++) {
+    if (reg == REG_MODE1 && !(data[i] & (1 << BIT_SLEEP))) {
+      uint8_t rest = (option << BIT_CTRL_AI) | nextReg(option, reg);
+      uint8_t status = sendTransfer(control, data, i + 1);
+
+      if (status != PCA9622_OK) {
+        markDirty(rest, count - i - 1);
+        return status;
+      }
+
+      return sendTransfer(rest, &data[i + 1], count - i - 1);
+    }
+    reg = nextReg(option, reg);
+  }
+
+  uint8_t status;
+  uint8_t attempt = 0;
+
+  oscillatorGuard(control, count);
+
+  do {
+    uint32_t start = micros();
+
+    _wire->beginTransmission(_deviceAddress);
+    _wire->write(control);
+    _wire->write(data, count);
+    status = _wire->endTransmission();
+
+    recordTransfer(status, count + 2, micros() - start);
+    PCA9622_TRACE_TRANSFER(start, _deviceAddress, control, count > 0 ? data[0] : 0, count, status);
+  } while (status != PCA9622_OK && retryAfter(attempt++));
+
+  _lastError = status;
+
+  reg = control & MASK_CTRL_REG;
+
+  for (uint8_t i = 0; status == PCA9622_OK && i < count; i++) {
+    if (reg == REG_MODE1) {
+      trackMode1(data[i]);
+    }
+    reg = nextReg(option, reg);
+  }
+
+  if (status != PCA9622_OK) {
+    _stats.errors++;
+    _transferFailed = true;
+
+    markDirty(control, count);
+  }
+
+  return status;
+}
+
+    /**
+    * Mark the registers of a transfer dirty, so the next flush sends them
+    *
+    * @param control Control byte with Auto-Increment option and register address
+    * @param count   Number of bytes of the transfer
+    */
+void PCA9622::markDirty(uint8_t control, uint8_t count) {
+
+  uint8_t option = control >> BIT_CTRL_AI;
+  uint8_t reg = control & MASK_CTRL_REG;
+
+  for (uint8_t i = 0; i < count; i++) {
+    if (reg < PCA9622_NUM_REGS) {
+      _dirtyRegs |= (1UL << reg);
+    }
+    reg = nextReg(option, reg);
+  }
+}
+
+    /**
+    * Wait for the oscillator if a transfer writes PWM or group registers
+    * right after waking up
+    *
+    * @param control Control byte with Auto-Increment option and register address
+    * @param count   Number of bytes to write
+    */
+void PCA9622::oscillatorGuard(uint8_t control, uint8_t count) {
+
+  uint8_t option = control >> BIT_CTRL_AI;
+  uint8_t reg = control & MASK_CTRL_REG;
+  bool touchesPwm = false;
+
+  for (uint8_t i = 0; i < count; i++) {
+    if (reg >= REG_PWM0 && reg <= REG_GRPFREQ) {
+      touchesPwm = true;
+    }
+    reg = nextReg(option, reg);
+  }
+
+  if (_oscStarting && touchesPwm) {
+    uint32_t elapsed = micros() - _wakeMicros;
+
+    if (elapsed < PCA9622_OSC_STARTUP_US) {
+      delayMicroseconds(PCA9622_OSC_STARTUP_US - elapsed);
+    }
+    _oscStarting = false;
+  }
+}
+
+    /**
+    * Follow the oscillator after MODE1 was written to the chip
+    *
+    * @param mode1 Value written to MODE1
+    */
+void PCA9622::trackMode1(uint8_t mode1) {
+
+  bool asleep = mode1 & (1 << BIT_SLEEP);
+
+  // The oscillator starts at the end of the transfer
+  if (_chipAsleep && !asleep) {
+    _wakeMicros = micros();
+    _oscStarting = true;
+  }
+  _chipAsleep = asleep;
+}
+
+    /**
+    * Count a switch between low-power and normal mode in the statistics and
+    * cancel automatic sleep, see sleep() and wakeUp()
+    *
+    * @param asleep true for low-power mode
+    *
+    * @return false if the chip already is in that mode
+    */
+bool PCA9622::countSleep(bool asleep) {
+
+  bool wasAsleep = _reg[REG_MODE1] & (1 << BIT_SLEEP);
+
+  _autoSlept = false;
+
+  if (asleep == wasAsleep) {
+    return false;
+  }
+
+  if (asleep) {
+    _stats.sleeps++;
+    _sleepStart = millis();
+  }
+  else {
+    _stats.wakeUps++;
+    _stats.sleepMillis += millis() - _sleepStart;
+  }
+
+  return true;
+}
+
+    /**
+    * Free a stuck bus: clock SCL until SDA is released, then generate a
+    * STOP, and restart wire
+    *
+    * @return true if both bus lines are high afterwards
+    */
+bool PCA9622::clearBus() {
+
+  _wire->end();
+
+  pinMode(_sdaPin, INPUT_PULLUP);
+  pinMode(_sclPin, INPUT_PULLUP);
+  delayMicroseconds(PCA9622_BUS_CLEAR_HALF_US);
+
+  // The device holding SDA low shifts out the rest of its byte, one bit per pulse
+  for (uint8_t i = 0; i < PCA9622_BUS_CLEAR_PULSES && digitalRead(_sdaPin) == LOW; i++) {
+    digitalWrite(_sclPin, LOW);
+    pinMode(_sclPin, OUTPUT);
+    delayMicroseconds(PCA9622_BUS_CLEAR_HALF_US);
+    pinMode(_sclPin, INPUT_PULLUP);
+    delayMicroseconds(PCA9622_BUS_CLEAR_HALF_US);
+  }
+
+  // STOP: SDA rises while SCL is high
+  digitalWrite(_sdaPin, LOW);
+  pinMode(_sdaPin, OUTPUT);
+  delayMicroseconds(PCA9622_BUS_CLEAR_HALF_US);
+  pinMode(_sdaPin, INPUT_PULLUP);
+  delayMicroseconds(PCA9622_BUS_CLEAR_HALF_US);
+
+  bool released = digitalRead(_sdaPin) == HIGH && digitalRead(_sclPin) == HIGH;
+
+  _wire->begin();
+
+  if (_clock != 0) {
+    _wire->setClock(_clock);
+  }
+
+  return released;
+}
+
+    /**
+    * Send all dirty registers, see flush()
+    */
+void PCA9622::flushDirty() {
+
+  // Failed transfers mark their registers dirty again, for the next flush
+  uint32_t pending = _dirtyRegs;
+  uint8_t first = REG_MODE1;
+
+  _dirtyRegs = 0;
+
+  while (pending != 0) {
+    while (first < PCA9622_NUM_REGS && !(pending & (1UL << first))) {
+      first++;
+    }
+
+    if (first >= PCA9622_NUM_REGS) {
+      break;
+    }
+
+    uint8_t last = first;
+
+    for (uint8_t reg = first + 1; reg < PCA9622_NUM_REGS && reg - last <= PCA9622_FLUSH_MAX_GAP + 1; reg++) {
+      if (pending & (1UL << reg)) {
+        last = reg;
+      }
+    }
+
+    pending &= ~(((1UL << (last + 1)) - 1) & ~((1UL << first) - 1));
+
+    transmit(AI_ALL, first, &_reg[first], last - first + 1);
+
+    first = last + 1;
+  }
+}
+
+    /**
+    * Wake up after automatic sleep if an output was turned on, and note when
+    * the outputs went off. Called after each write that was sent
+    */
+void PCA9622::autoWake() {
+
+  if (_autoSleepMillis == 0) {
+    return;
+  }
+
+  if (outputsOff()) {
+    if (!_idle) {
+      _idle = true;
+      _idleSince = millis();
+    }
+    return;
+  }
+
+  _idle = false;
+
+  if (_autoSlept) {
+    // Sent right away, also from within a flush in deferred mode
+    bool wasDeferred = _deferred;
+
+    _deferred = false;
+    wakeUp();
+    _deferred = wasDeferred;
+  }
+}
+
+    /**
+    * Save the LED driver output states for turnOn() and set _turnedOff. The
+    * states saved earlier are kept while all LEDs are still off, so calling
+    * turnOff() twice does not lose them
+    */
+void PCA9622::saveLedout() {
+
+  bool ledoutOff = (_reg[REG_LEDOUT0] | _reg[REG_LEDOUT1] | _reg[REG_LEDOUT2] | _reg[REG_LEDOUT3]) == LDR_STATE_OFF;
+
+  // Still off from the last turnOff(), keep the states saved there
+  if (_turnedOff && ledoutOff) {
+    return;
+  }
+
+  memcpy(_storedRegLedout, &_reg[REG_LEDOUT0], 4);
+  _turnedOff = true;
+}
+
+    /**
+    * Account for a transfer in the bus statistics
+    *
+    * @param status Status of the transfer
+    * @param bytes  Bytes on the bus, including address and control bytes
+    * @param micros Duration of the transfer
+    */
+void PCA9622::recordTransfer(uint8_t status, uint8_t bytes, uint32_t micros) {
+
+  _stats.transactions++;
+  _stats.bytes += bytes;
+  _stats.busMicros += micros;
+
+  if (status == PCA9622_ERR_NACK_ADDR || status == PCA9622_ERR_NACK_DATA) {
+    _stats.nacks++;
+  }
+  else if (status == PCA9622_ERR_TIMEOUT) {
+    _stats.timeouts++;
+  }
+}
+
+    /**
+    * Wait before repeating a failed transfer
+    *
+    * @param attempt Number of the attempt that failed, starting at 0
+    *
+    * @return true if the transfer shall be repeated
+    */
+bool PCA9622::retryAfter(uint8_t attempt) {
+
+  if (attempt >= _retries) {
+    return false;
+  }
+
+  _stats.retries++;
+
+  uint32_t backoff = (uint32_t) _retryBackoff << attempt;
+
+  delay(backoff / 1000);
+  delayMicroseconds(backoff % 1000);
+
+  return true;
+}
+
+    /**
+    * @param regPwm Register address for PWM channel
+    *
+    * @return true if the brightness correction table applies to the channel
+    */
+bool PCA9622::isCorrected(uint8_t regPwm) {
+
+  return _gammaTable != NULL && regPwm >= REG_PWM0 && regPwm <= REG_PWM15
+      && (_gammaChannels & (1 << (regPwm - REG_PWM0)));
+}
+
+    /**
+    * Apply the brightness correction table to a PWM value
+    *
+    * @param regPwm Register address for PWM channel
+    * @param pwm    PWM value
+    *
+    * @return corrected PWM value
+    */
+uint8_t PCA9622::correct(uint8_t regPwm, uint8_t pwm) {
+
+  if (!isCorrected(regPwm)) {
+    return pwm;
+  }
+
+  return PCA9622_GAMMA_READ(_gammaTable, pwm);
+}
+
+    /**
+    * Convert an on/off ratio for blinking to a GRPPWM value
+    *
+    * @param onOffPermille Time the LEDs are on in 1/1000 of the period
+    *
+    * @return GRPPWM value
+    */
+uint8_t PCA9622::blinkRatio(uint16_t onOffPermille) {
+
+  // Duty cycle = GRPPWM / 256
+  uint32_t ratio = ((uint32_t) onOffPermille * 256 + 500) / 1000;
+
+  if (ratio > 255) {
+    ratio = 255;
+  }
+
+  return (uint8_t) ratio;
+}
+
+    /**
+    * Convert an on/off ratio between 0.0 and 1.0 to permille. This is the
+    * only place where blinking uses floating point math
+    *
+    * @param onOffRatio Value between 0.0 and 1.0
+    *
+    * @return ratio in permille, 0 to 1000
+    */
+uint16_t PCA9622::permille(float onOffRatio) {
+
+  if (onOffRatio <= 0) {
+    return 0;
+  }
+  else if (onOffRatio >= 1) {
+    return 1000;
+  }
+
+  return (uint16_t) (onOffRatio * 1000 + 0.5f);
+}
+
+    /**
+    * Get the register address following a given one for an Auto-Increment
+    * option (page 9, table 4)
+    *
+    * @param option          Auto-Increment option (see AI_*)
+    * @param registerAddress Current register address
+    *
+    * @return next register address
+    */
+uint8_t PCA9622::nextReg(uint8_t option, uint8_t registerAddress) {
+
+  switch (option) {
+    case AI_ALL:
+      return (registerAddress >= REG_ALLCALLADR) ? REG_MODE1 : registerAddress + 1;
+
+    case AI_IND:
+      return (registerAddress >= REG_PWM15) ? REG_PWM0 : registerAddress + 1;
+
+    case AI_GBL:
+      return (registerAddress >= REG_GRPFREQ) ? REG_GRPPWM : registerAddress + 1;
+
+    case AI_IND_GBL:
+      return (registerAddress >= REG_GRPFREQ) ? REG_PWM0 : registerAddress + 1;
+
+    case AI_DISABLED:
+    default:
+      return registerAddress;
+  }
 }
\ No newline at end of file
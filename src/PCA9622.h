@@ -11,6 +11,8 @@
 
 #include <Wire.h>
 
+#include "PCA9622Gamma.h"
+
 // Register definitions (page 10, table 5)
 #define REG_MODE1      0x00 // Mode register 1
 #define REG_MODE2      0x01 // Mode register 2
@@ -41,6 +43,58 @@
 #define REG_SUBADR3    0x1A // I2C-bus subaddress 3
 #define REG_ALLCALLADR 0x1B // LED All Call I2C-bus address
 
+#define PCA9622_NUM_REGS 28 // Number of registers, REG_MODE1 to REG_ALLCALLADR
+
+// Transfer status, see getLastError(). 1 to 5 are the codes of TwoWire::endTransmission()
+#define PCA9622_OK            0 // Success
+#define PCA9622_ERR_TOO_LONG  1 // Data too long to fit in transmit buffer
+#define PCA9622_ERR_NACK_ADDR 2 // Received NACK on transmit of address
+#define PCA9622_ERR_NACK_DATA 3 // Received NACK on transmit of data
+#define PCA9622_ERR_OTHER     4 // Other bus error
+#define PCA9622_ERR_TIMEOUT   5 // Bus timeout (cores with setWireTimeout())
+#define PCA9622_ERR_READ      6 // Fewer bytes received than requested
+
+#define PCA9622_MAX_RETRIES 8 // Upper bound for setRetryPolicy()
+
+/**
+ * Bus statistics of one PCA9622, see PCA9622::getStats()
+ */
+struct PCA9622Stats {
+    uint32_t transactions;   // Transfers on the bus, including retries
+    uint32_t bytes;          // Bytes on the bus, including address and control bytes
+    uint32_t nacks;          // Transfers not acknowledged (address or data)
+    uint32_t retries;        // Transfers repeated after an error
+    uint32_t timeouts;       // Transfers ended by a bus timeout
+    uint32_t errors;         // Operations failed after all retries
+    uint32_t busMicros;      // Time spent in transfers
+    uint32_t sleeps;         // Switches to low-power mode
+    uint32_t wakeUps;        // Switches to normal mode
+    uint32_t sleepMillis;    // Time spent in low-power mode
+    uint32_t recoveries;     // Successful recover() calls
+    uint32_t recoveryMicros; // Time spent in successful recover() calls
+};
+
+// Power management
+#define PCA9622_OSC_STARTUP_US 500 // Oscillator start-up time after clearing SLEEP (page 11, table 6)
+
+// Bus recovery, see recover()
+#define PCA9622_NO_PIN            0xFF // Bus pins not set
+#define PCA9622_BUS_CLEAR_PULSES  9    // SCL pulses to free SDA (UM10204, 3.1.16)
+#define PCA9622_BUS_CLEAR_HALF_US 5    // Half SCL period of the bus clear, 100 kHz
+
+// Bus clock, see begin()
+#define PCA9622_CLOCK_STANDARD  100000  // Standard-mode, 100 kHz
+#define PCA9622_CLOCK_FAST      400000  // Fast-mode, 400 kHz
+#define PCA9622_CLOCK_FAST_PLUS 1000000 // Fast-mode Plus, 1 MHz
+
+// Scenes, see PCA9622Scene
+#define PCA9622_SCENE_FIRST_REG REG_PWM0                                    // First register of a scene
+#define PCA9622_SCENE_SIZE      (REG_LEDOUT3 - PCA9622_SCENE_FIRST_REG + 1) // PWM0 to LEDOUT3
+
+// Deferred writes, see flush()
+#define PCA9622_FLUSH_MAX_GAP 2 // Unchanged registers bridged within one transfer. A new transfer costs
+                                // START, address byte, control byte and STOP, i.e. slightly more than 2 bytes
+
 // Mode register 1, MODE1 (page 11, table 6)
 #define BIT_AI2     7 // 0: Register Auto-Increment disabled
                       // 1: Register Auto-Increment enabled
@@ -59,6 +113,8 @@
 #define BIT_ALLCALL 0 // 0: PCA9622 does not respond to LED All Call I2C-bus address
                       // 1: PCA9622 responds to LED All Call I2C-bus address
 
+#define MASK_MODE1_AI 0xE0 // AI2 to AI0, read only
+
 // Auto-Increment options, AIn (page 9, table 4)
 #define AI_DISABLED 0 // No Auto-Increment
 #define AI_ALL      4 // Auto-Increment for all registers. D[4:0] roll over to ‘0 0000’ after the last register (1 1011) is accessed
@@ -66,6 +122,10 @@
 #define AI_GBL      6 // Auto-Increment for global control registers only. D[4:0] roll over to ‘1 0010’ after the last register (1 0011) is accessed
 #define AI_IND_GBL  7 // Auto-Increment for individual and global control registers only. D[4:0] roll over to ‘0 0010’ after the last register (1 0011) is accessed
 
+// Control register (page 9, figure 7)
+#define BIT_CTRL_AI   5    // Lowest bit of the Auto-Increment option AI[2:0]
+#define MASK_CTRL_REG 0x1F // Register address D[4:0]
+
 // Mode register 2, MODE2 (page 11, table 7)
 #define BIT_DMBLNK  5 // 0: Group control = dimming
                       // 1: Group control = blinking
@@ -88,6 +148,10 @@
 #define GROUP_CONTROL_MODE_DIMMING  0 // Group control = dimming
 #define GROUP_CONTROL_MODE_BLINKING 1 // Group control = blinking
 
+// Output change options, OCH (page 11, table 7)
+#define OUTPUT_CHANGE_ON_STOP 0 // Outputs change on STOP command
+#define OUTPUT_CHANGE_ON_ACK  1 // Outputs change on ACK
+
 // PWM registers 0 to 3, PWMx
 
 //Group duty cycle control, GRPPWM
@@ -100,7 +164,11 @@
 #define BLINKING_PERIOD_2_S    48  //  48 = 2000ms / (1 / 24Hz)
 #define BLINKING_PERIOD_MAX    255 // 255 = 10.73s
 
-#define BLINKING_RATIO_BALANCED 0.5
+#define BLINKING_RATIO_BALANCED    0.5
+#define BLINKING_PERMILLE_BALANCED 500 // BLINKING_RATIO_BALANCED in permille
+
+#define BLINKING_PERIOD_MIN_MS 42    // (GRPFREQ + 1) / 24Hz, GRPFREQ = 0
+#define BLINKING_PERIOD_MAX_MS 10666 // (GRPFREQ + 1) / 24Hz, GRPFREQ = 255
 
 // LED driver output state, LEDOUT0 to LEDOUT3 (page 14, table 11)
 #define BIT_LDR3  6 // LED3  output state control
@@ -130,8 +198,59 @@
 
 // LED All Call I2C-bus address, ALLCALLADR
 
+/**
+ * Output image of a PCA9622: PWM0 to PWM15, GRPPWM, GRPFREQ and LEDOUT0 to
+ * LEDOUT3. Scenes are kept by the application, e.g. as an array with one
+ * entry per scene, see PCA9622::saveScene() and PCA9622::applyScene()
+ */
+struct PCA9622Scene {
+    uint8_t reg[PCA9622_SCENE_SIZE]; // Register values, starting at PCA9622_SCENE_FIRST_REG
+};
+
+/**
+ * Copy of the whole register file of a PCA9622, see PCA9622::snapshot()
+ * and PCA9622::restore()
+ */
+struct PCA9622Snapshot {
+    uint8_t reg[PCA9622_NUM_REGS]; // Register values, starting at REG_MODE1
+};
+
 class PCA9622 {
 
+    /**
+     * Broadcast writes through PCA9622Group keep the register cache of all
+     * members up to date
+     */
+    friend class PCA9622Group;
+
+    /**
+     * The frame buffer schedules transfers per bus
+     */
+    friend class PCA9622FrameBuffer;
+
+    /**
+     * The stream player writes recorded register ranges as they are
+     */
+    friend class PCA9622StreamPlayer;
+
+    /**
+     * Fixture views stage their changes in the register cache
+     */
+    friend class PCA9622View;
+
+    /**
+     * Register programs are recorded from the register cache and played
+     * as they are
+     */
+    friend class PCA9622Recorder;
+    friend class PCA9622ProgramPlayer;
+
+    /**
+     * The verifier compares the register cache with the chip and sends
+     * the registers that differ
+     */
+    friend class PCA9622Verifier;
+
 /******************************* PUBLIC METHODS *******************************/
 public:
 
@@ -144,6 +263,12 @@ public:
      */
     PCA9622(uint8_t regRedPwm, uint8_t regGreenPwm, uint8_t regBluePwm);
 
+    /**
+     * Constructor for a PCA9622 shared by several fixtures, see
+     * PCA9622RGBView. setRGB() and setRGBW() use channels 0 to 3
+     */
+    PCA9622();
+
     /**
      * Constructor for PCA9622 with RGBW
      *
@@ -160,8 +285,69 @@ public:
      *
      * @param deviceAddress I2C address of the PCA9622
      * @param wire          Reference to TwoWire for I2C communication
+     * @param clock         Bus clock in Hz (see PCA9622_CLOCK_*), 0 to keep
+     *                      the clock of wire
+     *
+     * @return PCA9622_OK or PCA9622_ERR_* of reading back the registers. On
+     *         failure the register cache holds the power-up defaults
+     */
+    uint8_t begin(uint8_t deviceAddress, TwoWire *wire, uint32_t clock = 0);
+
+    /**
+     * Take over a PCA9622 that is already running, e.g. after a reset of the
+     * microcontroller. Nothing is written, the register cache is loaded from
+     * the PCA9622 in a single read, so the outputs don't flash
+     *
+     * @param deviceAddress I2C address of the PCA9622
+     * @param wire          Reference to TwoWire for I2C communication
+     * @param clock         Bus clock in Hz (see PCA9622_CLOCK_*), 0 to keep
+     *                      the clock of wire
+     *
+     * @return PCA9622_OK or PCA9622_ERR_*
+     */
+    uint8_t attach(uint8_t deviceAddress, TwoWire *wire, uint32_t clock = 0);
+
+    /**
+     * Reload the register cache from the PCA9622 in a single read. Only
+     * needed when the registers may have changed without the driver knowing
+     * (e.g. after a reset of the device or when another bus master wrote to
+     * it)
+     *
+     * @return PCA9622_OK or PCA9622_ERR_*. On failure the register cache is
+     *         unchanged
+     */
+    uint8_t resync();
+
+    /**
+     * Read consecutive registers from the PCA9622 in a single Auto-Increment
+     * transfer. The register address rolls over from REG_ALLCALLADR to
+     * REG_MODE1. The register cache is not changed
+     *
+     * @param registerAddress First register address to read
+     * @param data            Buffer for count bytes, unchanged on failure
+     * @param count           Number of registers, at most PCA9622_NUM_REGS
+     *
+     * @return PCA9622_OK or PCA9622_ERR_*
+     */
+    uint8_t readRegs(uint8_t registerAddress, uint8_t *data, uint8_t count);
+
+    /**
+     * Read the whole register file of the PCA9622 in a single transfer
+     *
+     * @param snapshot Snapshot to fill, unchanged on failure
+     *
+     * @return PCA9622_OK or PCA9622_ERR_*
      */
-    void begin(uint8_t deviceAddress, TwoWire *wire);
+    uint8_t snapshot(PCA9622Snapshot &snapshot);
+
+    /**
+     * Write a snapshot back to the PCA9622 in a single Auto-Increment
+     * transfer and take it over into the register cache. In deferred mode
+     * only the registers that differ are staged
+     *
+     * @param snapshot Snapshot taken with snapshot()
+     */
+    void restore(const PCA9622Snapshot &snapshot);
 
     /**
      * Switch to low-power mode. Oscillator off
@@ -174,22 +360,36 @@ public:
     void wakeUp();
 
     /**
-     * Turn on all LEDs. Restores settings saved at turnOff()
-     *
-     * WARNING: If you call turnOff() twice without calling turnOn() in between,
-     *          then the restored state will be LDR_STATE_OFF!
+     * Turn on all LEDs. Restores the LED driver output states saved at
+     * turnOff() in a single transfer. Does nothing if the LEDs were not
+     * turned off
      */
     void turnOn();
 
     /**
-     * Turn off all LEDs. Saves current settings for turnOn()
-     * For power saving, see sleep()
-     *
-     * WARNING: If you call turnOff() twice without calling turnOn() in between,
-     *          then the restored state will be LDR_STATE_OFF!
+     * Turn off all LEDs in a single transfer. Saves the LED driver output
+     * states for turnOn(). Calling turnOff() again keeps the saved states
+     * unless LEDs were turned on in between. For power saving, see sleep()
      */
     void turnOff();
 
+    /**
+     * Save the current output image (see PCA9622Scene) from the register
+     * cache
+     *
+     * @param scene Scene to fill
+     */
+    void saveScene(PCA9622Scene &scene);
+
+    /**
+     * Switch to a scene. Only registers that differ from the current state
+     * are sent, in as few Auto-Increment transfers as flush() needs. In
+     * deferred mode the changes are only staged
+     *
+     * @param scene Scene to apply
+     */
+    void applyScene(const PCA9622Scene &scene);
+
     /**
      * Set individual PWM value for a given channel
      *
@@ -198,6 +398,18 @@ public:
      */
     void setPwm(uint8_t regPwm, uint8_t pwm);
 
+    /**
+     * Get the individual PWM value last set for a given channel. Taken from
+     * the register cache, nothing is read from the device. With a brightness
+     * table, the value is mapped back through the table, so setPwm() with it
+     * keeps the output unchanged
+     *
+     * @param regPwm Register address for PWM channel
+     *
+     * @return PWM value, before brightness correction
+     */
+    uint8_t getPwm(uint8_t regPwm);
+
     /**
      * Set global PWM value for all channels
      *
@@ -205,6 +417,46 @@ public:
      */
     void setGrpPwm(uint8_t pwm);
 
+    /**
+     * Set individual PWM values for all 16 channels in a single
+     * Auto-Increment transfer
+     *
+     * @param pwm Array of 16 PWM values, starting with channel 0
+     */
+    void setAllPwm(const uint8_t pwm[16]);
+
+    /**
+     * Set individual PWM values for consecutive channels in a single
+     * Auto-Increment transfer (AI_IND). After REG_PWM15 the transfer rolls
+     * over to REG_PWM0. The Auto-Increment option set with
+     * setAutoIncrement() is not changed
+     *
+     * @param regPwm Register address of the first PWM channel
+     * @param count  Number of channels to write (at most 16)
+     * @param pwm    PWM values
+     */
+    void setPwmRange(uint8_t regPwm, uint8_t count, const uint8_t *pwm);
+
+    /**
+     * Apply a brightness correction table to the color channels of this
+     * fixture (red, green, blue and, for RGBW, white). All individual PWM
+     * values are looked up in the table before they are written, including
+     * setAllPwm() and setPwmRange()
+     *
+     * @param table Table of 256 entries in flash (see PCA9622GammaTable),
+     *              or NULL to write PWM values unchanged
+     */
+    void setGammaTable(const uint8_t *table);
+
+    /**
+     * Apply a brightness correction table to a set of channels
+     *
+     * @param table       Table of 256 entries in flash (see PCA9622GammaTable),
+     *                    or NULL to write PWM values unchanged
+     * @param channelMask Bit n set to correct channel n (REG_PWM0 + n)
+     */
+    void setGammaTable(const uint8_t *table, uint16_t channelMask);
+
     /**
      * Set up values for blinking mode. Blinking mode needs to be activated
      * manually by calling setGroupControlMode(GROUP_CONTROL_MODE_BLINKING)
@@ -216,6 +468,43 @@ public:
      */
     void setBlinking(uint8_t blinkPeriod, float onOffRatio);
 
+    /**
+     * Set up values for blinking mode with integer math, see setBlinking()
+     *
+     * @param blinkPeriod   Period for one blink (turning off and on)
+     * @param onOffPermille Time the LEDs are on in 1/1000 of the period,
+     *                      0 to 1000
+     */
+    void setBlinkingPermille(uint8_t blinkPeriod, uint16_t onOffPermille);
+
+    /**
+     * Set up values for blinking mode from a period and on time in
+     * milliseconds. Both registers are sent in a single transfer. Blinking
+     * mode needs to be activated manually by calling
+     * setGroupControlMode(GROUP_CONTROL_MODE_BLINKING)
+     *
+     * @param periodMs Period for one blink, BLINKING_PERIOD_MIN_MS to
+     *                 BLINKING_PERIOD_MAX_MS
+     * @param onTimeMs Time the LEDs are on during one period
+     *
+     * @return false if the period can't be set in hardware, nothing is
+     *         written then
+     */
+    bool setBlinkingMs(uint16_t periodMs, uint16_t onTimeMs);
+
+    /**
+     * Compute the GRPFREQ and GRPPWM values for blinking with integer math
+     *
+     * @param periodMs Period for one blink in milliseconds
+     * @param onTimeMs Time the LEDs are on during one period in milliseconds
+     * @param grpFreq  GRPFREQ value
+     * @param grpPwm   GRPPWM value
+     *
+     * @return false if the period is outside BLINKING_PERIOD_MIN_MS to
+     *         BLINKING_PERIOD_MAX_MS
+     */
+    static bool blinkingRegs(uint16_t periodMs, uint16_t onTimeMs, uint8_t *grpFreq, uint8_t *grpPwm);
+
     /**
     * Set PWM values for RGB
     *
@@ -259,6 +548,15 @@ public:
     */
     void setLdrStateAll(uint8_t state);
 
+    /**
+    * Set the LED driver output state for a set of channels. Only LEDOUT
+    * registers that change are written, in a single transfer
+    *
+    * @param channelMask Bit n set for channel n (REG_PWM0 + n)
+    * @param state       One of the four possible states (see LDR_STATE_*)
+    */
+    void setLdrStates(uint16_t channelMask, uint8_t state);
+
     /**
     * Set an option for auto increment. There are five options:
     *   - AI_DISABLED
@@ -280,6 +578,220 @@ public:
     */
     void setGroupControlMode(uint8_t mode);
 
+    /**
+    * Set when the outputs follow written registers. There are two options:
+    *   - OUTPUT_CHANGE_ON_STOP
+    *   - OUTPUT_CHANGE_ON_ACK
+    *
+    * @param option One of the two possible options
+    */
+    void setOutputChange(uint8_t option);
+
+    /**
+    * Start a frame. Until commitFrame(), all setters only update the
+    * register cache (see setDeferred())
+    */
+    void beginFrame();
+
+    /**
+    * Send all changes since beginFrame() so they become visible at the
+    * same time. Outputs are switched to change on STOP, and all changed
+    * PWM, GRPPWM, GRPFREQ and LEDOUT registers are sent in a single
+    * Auto-Increment transfer, so they are applied together by its STOP
+    */
+    void commitFrame();
+
+    /**
+    * Send all staged changes, e.g. of fixture views (see PCA9622RGBView).
+    * Changed PWM, GRPPWM, GRPFREQ and LEDOUT registers are sent in a single
+    * Auto-Increment transfer, after all other changed registers
+    */
+    void commit();
+
+    /**
+    * Enable or disable deferred writes. While enabled, all setters only
+    * update the register cache and mark changed registers as dirty. Nothing
+    * is sent to the PCA9622 until flush() is called. Disabling deferred
+    * writes flushes pending changes
+    *
+    * @param deferred true to defer writes until flush()
+    */
+    void setDeferred(bool deferred);
+
+    /**
+    * @return true if writes are deferred until flush()
+    */
+    bool isDeferred();
+
+    /**
+    * Send all registers changed since the last flush() to the PCA9622.
+    * Registers written with their current value are skipped. Dirty
+    * registers are merged into as few Auto-Increment transfers as possible;
+    * gaps of up to PCA9622_FLUSH_MAX_GAP unchanged registers are sent along
+    * when that is cheaper than starting a new transfer
+    */
+    void flush();
+
+    /**
+    * Enable asynchronous writes. All writes are appended to a queue in the
+    * given buffer and sent by poll(), so setters return without waiting for
+    * the bus. Each queued transfer takes its data size plus 2 bytes. When the
+    * queue is full, a write waits for room by calling poll() itself (see
+    * queueStalls()). Reads always wait for the queue to drain first
+    *
+    * @param buffer Memory for the queue. Must stay valid until endQueue()
+    * @param size   Size of buffer in bytes
+    */
+    void beginQueue(uint8_t *buffer, uint16_t size);
+
+    /**
+    * Send all queued transfers and switch back to synchronous writes
+    */
+    void endQueue();
+
+    /**
+    * Send the oldest queued transfer, if any. Call this regularly from the
+    * main loop or from a timer when asynchronous writes are enabled
+    *
+    * @return true if more transfers are queued
+    */
+    bool poll();
+
+    /**
+    * Token of the most recently queued transfer, to be used with
+    * isComplete() and wait()
+    *
+    * @return completion token
+    */
+    uint16_t lastToken();
+
+    /**
+    * Check whether a queued transfer was sent
+    *
+    * @param token Completion token from lastToken()
+    *
+    * @return true if the transfer and all transfers queued before it were sent
+    */
+    bool isComplete(uint16_t token);
+
+    /**
+    * Send queued transfers until the given one was sent
+    *
+    * @param token Completion token from lastToken()
+    */
+    void wait(uint16_t token);
+
+    /**
+    * Free space in the queue
+    *
+    * @return free bytes, a transfer needs its data size plus 2 bytes
+    */
+    uint16_t queueFree();
+
+    /**
+    * Number of writes that had to wait for room in the queue since
+    * beginQueue(). A growing number means poll() is not called often enough
+    *
+    * @return number of stalled writes
+    */
+    uint16_t queueStalls();
+
+    /**
+    * Register a function that is called after each queued transfer was sent
+    *
+    * @param callback Function receiving the completion token, or NULL
+    */
+    void onComplete(void (*callback)(uint16_t token));
+
+    /**
+    * Set how failed transfers are repeated. Between attempts, the driver
+    * waits backoffMicros, doubling the wait after each attempt. Registers of
+    * a write that failed after all retries stay dirty and are sent again by
+    * the next flush()
+    *
+    * @param retries       Number of repetitions, at most PCA9622_MAX_RETRIES
+    * @param backoffMicros Wait before the first repetition in microseconds
+    */
+    void setRetryPolicy(uint8_t retries, uint16_t backoffMicros);
+
+    /**
+    * Status of the last transfer (see PCA9622_OK and PCA9622_ERR_*)
+    *
+    * @return status
+    */
+    uint8_t getLastError();
+
+    /**
+    * Bus statistics since begin() or resetStats()
+    *
+    * @return statistics
+    */
+    const PCA9622Stats &getStats();
+
+    /**
+    * Clear the bus statistics
+    */
+    void resetStats();
+
+    /**
+    * Put the PCA9622 to sleep automatically while all outputs are off (all
+    * LDR_STATE_OFF, or individual PWM 0). After idleMillis without output,
+    * updatePower() switches to low-power mode. The next write that turns an
+    * output on wakes the PCA9622 again, once, after its data was sent
+    *
+    * @param idleMillis Idle time before sleeping, 0 to disable
+    */
+    void setAutoSleep(uint32_t idleMillis);
+
+    /**
+    * Switch to low-power mode if the automatic sleep time has elapsed. Call
+    * this regularly from the main loop, see setAutoSleep()
+    */
+    void updatePower();
+
+    /**
+    * @return true if no output is on according to the register cache
+    */
+    bool outputsOff();
+
+    /**
+    * Set the pins of the bus lines, for the bus clear in recover(). Without
+    * them, recover() only writes the register image
+    *
+    * @param sdaPin Pin number of SDA
+    * @param sclPin Pin number of SCL
+    */
+    void setBusPins(uint8_t sdaPin, uint8_t sclPin);
+
+    /**
+    * Check that the PCA9622 still holds the register image of the driver,
+    * and recover() if not. A transfer that failed since the last check, a
+    * stuck bus or a PCA9622 back at its power-up defaults after a reset
+    * trigger the recovery. Costs a two-byte read while all is well. Call
+    * this regularly from the main loop
+    *
+    * @return PCA9622_OK if healthy or recovered, otherwise PCA9622_ERR_*
+    */
+    uint8_t checkHealth();
+
+    /**
+    * Recover after a bus glitch or a reset of the PCA9622. A stuck bus is
+    * freed with the bus clear sequence if the bus pins are set, then the
+    * whole register cache is written, the registers after MODE1 once the
+    * oscillator runs. Queued transfers are dropped, their data is part of
+    * the register cache. Registers staged in deferred mode are written as
+    * well and stay dirty for the next flush
+    *
+    * @return PCA9622_OK or PCA9622_ERR_*
+    */
+    uint8_t recover();
+
+    /**
+    * @return duration of the last successful recover() in microseconds,
+    *         including the bus clear
+    */
+    uint32_t lastRecoveryMicros();
+
 /****************************** PRIVATE METHODS *******************************/
 private:
 
@@ -294,16 +806,111 @@ private:
      bool _hasWhiteChannel;
 
     /**
-     * Stored register content of LEDOUT when writing LDR_STATE_OFF to all LDRs
-     * when calling turnOff()
+     * Stored register content of LEDOUT0 to LEDOUT3 when writing
+     * LDR_STATE_OFF to all LDRs when calling turnOff(), valid while
+     * _turnedOff is set
+     */
+    uint8_t _storedRegLedout[4];
+    bool _turnedOff;
+
+    /**
+     * Cached content of all registers, REG_MODE1 to REG_ALLCALLADR. Holds
+     * the power-up defaults until seeded in begin() and is updated on every
+     * write, so read-modify-write operations don't need to read from the
+     * device
+     */
+    uint8_t _reg[PCA9622_NUM_REGS];
+
+    /**
+     * Brightness correction table in flash and channels it applies to
+     */
+    const uint8_t *_gammaTable;
+    uint16_t _gammaChannels;
+
+    /**
+     * Bit n is set when register n was changed in the register cache but not
+     * yet sent to the device (deferred writes only)
+     */
+    uint32_t _dirtyRegs;
+
+    /**
+     * Indicates whether writes are deferred until flush()
      */
-    uint8_t _storedRegLedout0;
-    uint8_t _storedRegLedout1;
-    uint8_t _storedRegLedout2;
-    uint8_t _storedRegLedout3;
+    bool _deferred;
 
     /**
-    * Write data to a register
+     * Retry policy, status of the last transfer and bus statistics
+     */
+    uint8_t _retries;
+    uint16_t _retryBackoff;
+    uint8_t _lastError;
+    PCA9622Stats _stats;
+
+    /**
+     * Deferred mode before beginFrame()
+     */
+    bool _frameWasDeferred;
+
+    /**
+     * Automatic sleep, see setAutoSleep(). _idleSince is the time the
+     * outputs were found off, _autoSlept is set while asleep due to idling
+     */
+    uint32_t _autoSleepMillis;
+    uint32_t _idleSince;
+    bool _idle;
+    bool _autoSlept;
+
+    /**
+     * Start of the current low-power phase, for PCA9622Stats::sleepMillis
+     */
+    uint32_t _sleepStart;
+
+    /**
+     * SLEEP bit as last sent to the PCA9622. After waking up, writes to the
+     * PWM and group registers wait for the oscillator until
+     * _wakeMicros + PCA9622_OSC_STARTUP_US
+     */
+    bool _chipAsleep;
+    bool _oscStarting;
+    uint32_t _wakeMicros;
+
+    /**
+     * Queue for asynchronous writes, NULL for synchronous writes. Each entry
+     * holds control byte, data size and data
+     */
+    uint8_t *_queue;
+    uint16_t _queueSize;
+    uint16_t _queueHead;
+    uint16_t _queueUsed;
+    uint16_t _queueStalls;
+
+    /**
+     * Tokens of the last queued and the last sent transfer
+     */
+    uint16_t _queuedToken;
+    uint16_t _sentToken;
+
+    /**
+     * Called after each queued transfer was sent
+     */
+    void (*_onComplete)(uint16_t token);
+
+    /**
+     * Bus lines for the bus clear, PCA9622_NO_PIN if not set, and the bus
+     * clock to set again after the bus was restarted, 0 to keep it
+     */
+    uint8_t _sdaPin;
+    uint8_t _sclPin;
+    uint32_t _clock;
+
+    /**
+     * A transfer failed since the last checkHealth() or recover()
+     */
+    bool _transferFailed;
+    uint32_t _recoveryMicros;
+
+    /**
+    * Write data to a register and update the register cache
     *
     * @param registerAddress Register address to write to
     * @param data            Data to write
@@ -311,14 +918,184 @@ private:
     void writeReg(uint8_t registerAddress, uint8_t data);
 
     /**
-    * Read data from a register
+    * Write data to consecutive registers in one transfer and update the
+    * register cache. The register address follows the rollover rules of the
+    * given Auto-Increment option
     *
-    * @param registerAddress Register address to read from
-     *
-     * @return byte read from given registerAddress
-     * @return -1 if no byte was available to be read
+    * @param option          Auto-Increment option for this transfer (see AI_*)
+    * @param registerAddress First register address to write to
+    * @param data            Data to write
+    * @param count           Number of bytes to write
+    */
+    void writeRegs(uint8_t option, uint8_t registerAddress, const uint8_t *data, uint8_t count);
+
+    /**
+    * Update consecutive registers in the register cache and clear their
+    * dirty bits, e.g. after a transfer to a group address
+    *
+    * @param option          Auto-Increment option of the transfer (see AI_*)
+    * @param registerAddress First register address written
+    * @param data            Data written
+    * @param count           Number of bytes written
+    */
+    void cacheRegs(uint8_t option, uint8_t registerAddress, const uint8_t *data, uint8_t count);
+
+    /**
+    * Update a register in the register cache and mark it dirty if changed
+    *
+    * @param registerAddress Register address to update
+    * @param data            New register content
+    */
+    void stageReg(uint8_t registerAddress, uint8_t data);
+
+    /**
+    * Send data to consecutive registers in one transfer, or queue it when
+    * asynchronous writes are enabled. Does not touch the register cache
+    *
+    * @param option          Auto-Increment option for this transfer (see AI_*)
+    * @param registerAddress First register address to write to
+    * @param data            Data to write
+    * @param count           Number of bytes to write
+    */
+    void transmit(uint8_t option, uint8_t registerAddress, const uint8_t *data, uint8_t count);
+
+    /**
+    * Send one transfer on the bus, repeated according to the retry policy.
+    * A transfer in which MODE1 clears SLEEP is split after MODE1. On failure,
+    * the registers written are marked dirty
+    *
+    * @param control Control byte with Auto-Increment option and register address
+    * @param data    Data to write
+    * @param count   Number of bytes to write
+    *
+    * @return PCA9622_OK or PCA9622_ERR_*
+    */
+    uint8_t sendTransfer(uint8_t control, const uint8_t *data, uint8_t count);
+
+    /**
+    * Mark the registers of a transfer dirty, so the next flush sends them
+    *
+    * @param control Control byte with Auto-Increment option and register address
+    * @param count   Number of bytes of the transfer
+    */
+    void markDirty(uint8_t control, uint8_t count);
+
+    /**
+    * Wait for the oscillator if a transfer writes PWM or group registers
+    * right after waking up
+    *
+    * @param control Control byte with Auto-Increment option and register address
+    * @param count   Number of bytes to write
+    */
+    void oscillatorGuard(uint8_t control, uint8_t count);
+
+    /**
+    * Follow the oscillator after MODE1 was written to the chip
+    *
+    * @param mode1 Value written to MODE1
+    */
+    void trackMode1(uint8_t mode1);
+
+    /**
+    * Count a switch between low-power and normal mode in the statistics and
+    * cancel automatic sleep, see sleep() and wakeUp()
+    *
+    * @param asleep true for low-power mode
+    *
+    * @return false if the chip already is in that mode
+    */
+    bool countSleep(bool asleep);
+
+    /**
+    * Free a stuck bus: clock SCL until SDA is released, then generate a
+    * STOP, and restart wire
+    *
+    * @return true if both bus lines are high afterwards
+    */
+    bool clearBus();
+
+    /**
+    * Send all dirty registers, see flush()
+    */
+    void flushDirty();
+
+    /**
+    * Wake up after automatic sleep if an output was turned on, and note when
+    * the outputs went off. Called after each write that was sent
+    */
+    void autoWake();
+
+    /**
+    * Save the LED driver output states for turnOn() and set _turnedOff. The
+    * states saved earlier are kept while all LEDs are still off, so calling
+    * turnOff() twice does not lose them
+    */
+    void saveLedout();
+
+    /**
+    * Account for a transfer in the bus statistics
+    *
+    * @param status Status of the transfer
+    * @param bytes  Bytes on the bus, including address and control bytes
+    * @param micros Duration of the transfer
+    */
+    void recordTransfer(uint8_t status, uint8_t bytes, uint32_t micros);
+
+    /**
+    * Wait before repeating a failed transfer
+    *
+    * @param attempt Number of the attempt that failed, starting at 0
+    *
+    * @return true if the transfer shall be repeated
+    */
+    bool retryAfter(uint8_t attempt);
+
+    /**
+    * @param regPwm Register address for PWM channel
+    *
+    * @return true if the brightness correction table applies to the channel
+    */
+    bool isCorrected(uint8_t regPwm);
+
+    /**
+    * Apply the brightness correction table to a PWM value
+    *
+    * @param regPwm Register address for PWM channel
+    * @param pwm    PWM value
+    *
+    * @return corrected PWM value
+    */
+    uint8_t correct(uint8_t regPwm, uint8_t pwm);
+
+    /**
+    * Convert an on/off ratio for blinking to a GRPPWM value
+    *
+    * @param onOffPermille Time the LEDs are on in 1/1000 of the period
+    *
+    * @return GRPPWM value
+    */
+    static uint8_t blinkRatio(uint16_t onOffPermille);
+
+    /**
+    * Convert an on/off ratio between 0.0 and 1.0 to permille. This is the
+    * only place where blinking uses floating point math
+    *
+    * @param onOffRatio Value between 0.0 and 1.0
+    *
+    * @return ratio in permille, 0 to 1000
+    */
+    static uint16_t permille(float onOffRatio);
+
+    /**
+    * Get the register address following a given one for an Auto-Increment
+    * option (page 9, table 4)
+    *
+    * @param option          Auto-Increment option (see AI_*)
+    * @param registerAddress Current register address
+    *
+    * @return next register address
     */
-    uint8_t readReg(uint8_t registerAddress);
+    static uint8_t nextReg(uint8_t option, uint8_t registerAddress);
 
     /**
      * I2C address of device.
@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#include "PCA9622Animator.h"
+
+/******************************* PUBLIC METHODS *******************************/
+
+
+    /**
+     * Constructor for PCA9622Animator
+     *
+     * @param fades    Array of fade slots, one per concurrently running fade.
+     *                 Must stay valid for the lifetime of the animator
+     * @param numFades Number of fade slots
+     */
+PCA9622Animator::PCA9622Animator(PCA9622Fade *fades, uint16_t numFades) {
+
+  _fades = fades;
+  _numFades = numFades;
+  _fadesPerTick = 0;
+  _nextFade = 0;
+  _numDevices = 0;
+
+  for (uint16_t i = 0; i < numFades; i++) {
+    _fades[i].device = NULL;
+  }
+}
+
+    /**
+     * Start fading a channel from its current PWM value to a target value.
+     * A fade already running on the channel is replaced
+     *
+     * @param device   PCA9622 of the channel
+     * @param regPwm   Register address for PWM channel
+     * @param target   PWM value at the end of the fade
+     * @param duration Duration of the fade in microseconds
+     * @param now      Current time in microseconds, e.g. micros()
+     *
+     * @return false if no fade slot is free
+     */
+bool PCA9622Animator::fadeTo(PCA9622 *device, uint8_t regPwm, uint8_t target, uint32_t duration, uint32_t now) {
+
+  PCA9622Fade *fade = findFade(device, regPwm);
+  uint8_t start;
+
+  // A replaced fade continues from the value it sent last, before brightness correction
+  if (fade != NULL) {
+    start = fade->last;
+  }
+  else {
+    start = device->getPwm(regPwm);
+    fade = findFade(NULL, 0);
+  }
+
+  if (fade == NULL) {
+    return false;
+  }
+
+  // Scale the duration down to 16 bits, so the fraction elapsed/duration
+  // can be computed as a 16.16 fixed-point value with 32-bit math
+  uint8_t shift = 0;
+
+  while ((duration >> shift) > 0xFFFF) {
+    shift++;
+  }
+
+  fade->device = device;
+  fade->regPwm = regPwm;
+  fade->start = start;
+  fade->target = target;
+  fade->last = start;
+  fade->shift = shift;
+  fade->duration = duration >> shift;
+  fade->startTime = now;
+
+  return true;
+}
+
+    /**
+     * Stop a running fade. The channel keeps its current PWM value
+     *
+     * @param device PCA9622 of the channel
+     * @param regPwm Register address for PWM channel
+     */
+void PCA9622Animator::cancel(PCA9622 *device, uint8_t regPwm) {
+
+  PCA9622Fade *fade = findFade(device, regPwm);
+
+  if (fade != NULL) {
+    fade->device = NULL;
+  }
+}
+
+    /**
+     * Limit the number of fades computed per tick(). Fades are then
+     * processed round-robin over several ticks, which bounds the CPU time of
+     * one tick
+     *
+     * @param maxFades Fades per tick, 0 for no limit
+     */
+void PCA9622Animator::setFadesPerTick(uint16_t maxFades) {
+
+  _fadesPerTick = maxFades;
+}
+
+    /**
+     * Advance all running fades and write changed channels. On a device in
+     * deferred mode, the changes are only staged until its next flush()
+     *
+     * @param now Current time in microseconds, e.g. micros()
+     */
+void PCA9622Animator::tick(uint32_t now) {
+
+  uint16_t count = (_fadesPerTick == 0 || _fadesPerTick > _numFades) ? _numFades : _fadesPerTick;
+
+  for (uint16_t n = 0; n < count; n++) {
+    PCA9622Fade &fade = _fades[_nextFade];
+
+    _nextFade = (_nextFade + 1 < _numFades) ? _nextFade + 1 : 0;
+
+    if (fade.device == NULL) {
+      continue;
+    }
+
+    uint32_t elapsed = (now - fade.startTime) >> fade.shift;
+    uint8_t pwm;
+
+    if (elapsed >= fade.duration) {
+      pwm = fade.target;
+    }
+    else {
+      // 16.16 fixed point, elapsed < duration <= 0xFFFF
+      uint32_t fraction = (elapsed << 16) / fade.duration;
+      int16_t delta = (int16_t) fade.target - fade.start;
+
+      pwm = fade.start + (int16_t) ((delta * (int32_t) fraction + 0x8000) >> 16);
+    }
+
+    if (pwm != fade.last) {
+      emit(fade.device, fade.regPwm, pwm);
+      fade.last = pwm;
+    }
+
+    if (elapsed >= fade.duration) {
+      fade.device = NULL;
+    }
+  }
+
+  // Devices that were already deferred keep the changes staged for the caller's flush
+  for (uint8_t i = 0; i < _numDevices; i++) {
+    if (!_wasDeferred[i]) {
+      _devices[i]->setDeferred(false);
+    }
+  }
+
+  _numDevices = 0;
+}
+
+    /**
+     * @return number of running fades
+     */
+uint16_t PCA9622Animator::activeFades() {
+
+  uint16_t active = 0;
+
+  for (uint16_t i = 0; i < _numFades; i++) {
+    if (_fades[i].device != NULL) {
+      active++;
+    }
+  }
+
+  return active;
+}
+
+/****************************** PRIVATE METHODS *******************************/
+
+
+    /**
+     * Find the fade slot of a channel
+     *
+     * @return slot, or NULL if the channel is not fading
+     */
+PCA9622Fade *PCA9622Animator::findFade(PCA9622 *device, uint8_t regPwm) {
+
+  for (uint16_t i = 0; i < _numFades; i++) {
+    if (_fades[i].device == device && (device == NULL || _fades[i].regPwm == regPwm)) {
+      return &_fades[i];
+    }
+  }
+
+  return NULL;
+}
+
+    /**
+     * Write a PWM value, batching it on the device until the end of tick()
+     */
+void PCA9622Animator::emit(PCA9622 *device, uint8_t regPwm, uint8_t pwm) {
+
+  bool batched = false;
+
+  for (uint8_t i = 0; i < _numDevices && !batched; i++) {
+    batched = (_devices[i] == device);
+  }
+
+  if (!batched && _numDevices < PCA9622_ANIMATOR_MAX_DEVICES) {
+    _devices[_numDevices] = device;
+    _wasDeferred[_numDevices] = device->isDeferred();
+    _numDevices++;
+
+    device->setDeferred(true);
+  }
+
+  device->setPwm(regPwm, pwm);
+}
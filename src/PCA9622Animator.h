@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef PCA9622_ANIMATOR_H
+#define PCA9622_ANIMATOR_H
+
+#include "PCA9622.h"
+
+#define PCA9622_ANIMATOR_MAX_DEVICES 32 // Devices batched per tick, further devices are written directly
+
+/**
+ * State of one running fade. Provided by the application as an array, see
+ * PCA9622Animator
+ */
+struct PCA9622Fade {
+    PCA9622 *device;     // Device of the channel, NULL if the slot is free
+    uint8_t regPwm;      // Register address for PWM channel
+    uint8_t start;       // PWM value at the start of the fade
+    uint8_t target;      // PWM value at the end of the fade
+    uint8_t last;        // PWM value last sent
+    uint8_t shift;       // Duration and elapsed time are scaled down by 2^shift to fit 16 bits
+    uint16_t duration;   // Duration in us >> shift
+    uint32_t startTime;  // Start time in us
+};
+
+/**
+ * Fades PWM channels of one or more PCA9622 over time. Intermediate values
+ * are computed with integer math only. On each tick(), only channels whose
+ * PWM value changed are written, and all changes of a device are sent
+ * together with PCA9622::flush()
+ */
+class PCA9622Animator {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Constructor for PCA9622Animator
+     *
+     * @param fades    Array of fade slots, one per concurrently running fade.
+     *                 Must stay valid for the lifetime of the animator
+     * @param numFades Number of fade slots
+     */
+    PCA9622Animator(PCA9622Fade *fades, uint16_t numFades);
+
+    /**
+     * Start fading a channel from its current PWM value to a target value.
+     * A fade already running on the channel is replaced
+     *
+     * @param device   PCA9622 of the channel
+     * @param regPwm   Register address for PWM channel
+     * @param target   PWM value at the end of the fade
+     * @param duration Duration of the fade in microseconds
+     * @param now      Current time in microseconds, e.g. micros()
+     *
+     * @return false if no fade slot is free
+     */
+    bool fadeTo(PCA9622 *device, uint8_t regPwm, uint8_t target, uint32_t duration, uint32_t now);
+
+    /**
+     * Stop a running fade. The channel keeps its current PWM value
+     *
+     * @param device PCA9622 of the channel
+     * @param regPwm Register address for PWM channel
+     */
+    void cancel(PCA9622 *device, uint8_t regPwm);
+
+    /**
+     * Limit the number of fades computed per tick(). Fades are then
+     * processed round-robin over several ticks, which bounds the CPU time of
+     * one tick
+     *
+     * @param maxFades Fades per tick, 0 for no limit
+     */
+    void setFadesPerTick(uint16_t maxFades);
+
+    /**
+     * Advance all running fades and write changed channels. On a device in
+     * deferred mode, the changes are only staged until its next flush()
+     *
+     * @param now Current time in microseconds, e.g. micros()
+     */
+    void tick(uint32_t now);
+
+    /**
+     * @return number of running fades
+     */
+    uint16_t activeFades();
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+    /**
+     * Find the fade slot of a channel
+     *
+     * @return slot, or NULL if the channel is not fading
+     */
+    PCA9622Fade *findFade(PCA9622 *device, uint8_t regPwm);
+
+    /**
+     * Write a PWM value, batching it on the device until the end of tick()
+     */
+    void emit(PCA9622 *device, uint8_t regPwm, uint8_t pwm);
+
+    PCA9622Fade *_fades;
+    uint16_t _numFades;
+    uint16_t _fadesPerTick;
+    uint16_t _nextFade;
+
+    /**
+     * Devices written during the current tick() and whether they were in
+     * deferred mode before
+     */
+    PCA9622 *_devices[PCA9622_ANIMATOR_MAX_DEVICES];
+    bool _wasDeferred[PCA9622_ANIMATOR_MAX_DEVICES];
+    uint8_t _numDevices;
+};
+#endif //PCA9622_ANIMATOR_H
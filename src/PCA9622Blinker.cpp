@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#include "PCA9622Blinker.h"
+
+/******************************* PUBLIC METHODS *******************************/
+
+
+    /**
+     * Constructor for PCA9622Blinker
+     *
+     * @param blinks    Array of pattern slots. Must stay valid for the
+     *                  lifetime of the planner
+     * @param numBlinks Number of pattern slots
+     */
+PCA9622Blinker::PCA9622Blinker(PCA9622Blink *blinks, uint16_t numBlinks) {
+
+  _blinks = blinks;
+  _numBlinks = numBlinks;
+
+  for (uint16_t i = 0; i < numBlinks; i++) {
+    _blinks[i].device = NULL;
+  }
+}
+
+    /**
+     * Start blinking channels. Patterns already running on any of the
+     * channels are stopped. An on time of 0 turns the channels off, an on
+     * time of at least the period turns them on, both without a pattern slot
+     *
+     * @param device   PCA9622 of the channels
+     * @param channels Bit n set for channel n (REG_PWM0 + n)
+     * @param periodMs Period in milliseconds
+     * @param onTimeMs On time per period in milliseconds
+     * @param now      Current time in milliseconds, e.g. millis()
+     *
+     * @return BLINK_HARDWARE, BLINK_SOFTWARE or BLINK_FAILED
+     */
+uint8_t PCA9622Blinker::blink(PCA9622 *device, uint16_t channels, uint16_t periodMs, uint16_t onTimeMs, uint32_t now) {
+
+  bool wasDeferred = device->isDeferred();
+  uint8_t result = BLINK_HARDWARE;
+
+  // Collect all register changes and send them with a single flush()
+  device->setDeferred(true);
+  release(device, channels);
+
+  if (onTimeMs == 0 || onTimeMs >= periodMs) {
+    device->setLdrStates(channels, (onTimeMs == 0) ? LDR_STATE_OFF : LDR_STATE_IND);
+  }
+  else {
+    uint8_t grpFreq;
+    uint8_t grpPwm;
+    PCA9622Blink *shared = hardwareSlot(device);
+    bool inHardware = PCA9622::blinkingRegs(periodMs, onTimeMs, &grpFreq, &grpPwm);
+
+    if (inHardware && shared != NULL) {
+      // The blink generator is in use, share it if the registers match
+      uint8_t sharedFreq;
+      uint8_t sharedPwm;
+
+      PCA9622::blinkingRegs(shared->period, shared->onTime, &sharedFreq, &sharedPwm);
+      inHardware = (sharedFreq == grpFreq && sharedPwm == grpPwm);
+    }
+
+    if (inHardware && shared != NULL) {
+      shared->channels |= channels;
+      device->setLdrStates(channels, LDR_STATE_IND_GRP);
+    }
+    else {
+      PCA9622Blink *slot = freeSlot();
+
+      if (slot == NULL) {
+        result = BLINK_FAILED;
+      }
+      else {
+        slot->device = device;
+        slot->channels = channels;
+        slot->period = periodMs;
+        slot->onTime = onTimeMs;
+        slot->start = now;
+        slot->hardware = inHardware;
+        slot->on = true;
+
+        if (inHardware) {
+          device->setBlinkingMs(periodMs, onTimeMs);
+          device->setGroupControlMode(GROUP_CONTROL_MODE_BLINKING);
+          device->setLdrStates(channels, LDR_STATE_IND_GRP);
+        }
+        else {
+          device->setLdrStates(channels, LDR_STATE_IND);
+          result = BLINK_SOFTWARE;
+        }
+      }
+    }
+  }
+
+  device->flush();
+  device->setDeferred(wasDeferred);
+
+  return result;
+}
+
+    /**
+     * Stop blinking channels and leave them on with their individual
+     * brightness (LDR_STATE_IND)
+     *
+     * @param device   PCA9622 of the channels
+     * @param channels Bit n set for channel n (REG_PWM0 + n)
+     */
+void PCA9622Blinker::stop(PCA9622 *device, uint16_t channels) {
+
+  bool wasDeferred = device->isDeferred();
+
+  device->setDeferred(true);
+  release(device, channels);
+  device->flush();
+  device->setDeferred(wasDeferred);
+}
+
+    /**
+     * Toggle the channels of software patterns. Writes only when a pattern
+     * changes state, hardware patterns never cause traffic here
+     *
+     * @param now Current time in milliseconds, e.g. millis()
+     */
+void PCA9622Blinker::tick(uint32_t now) {
+
+  for (uint16_t i = 0; i < _numBlinks; i++) {
+    PCA9622Blink &blink = _blinks[i];
+
+    if (blink.device == NULL || blink.hardware) {
+      continue;
+    }
+
+    bool on = ((now - blink.start) % blink.period) < blink.onTime;
+
+    if (on != blink.on) {
+      blink.device->setLdrStates(blink.channels, on ? LDR_STATE_IND : LDR_STATE_OFF);
+      blink.on = on;
+    }
+  }
+}
+
+    /**
+     * @return number of patterns running in software
+     */
+uint16_t PCA9622Blinker::softwarePatterns() {
+
+  uint16_t patterns = 0;
+
+  for (uint16_t i = 0; i < _numBlinks; i++) {
+    if (_blinks[i].device != NULL && !_blinks[i].hardware) {
+      patterns++;
+    }
+  }
+
+  return patterns;
+}
+
+/****************************** PRIVATE METHODS *******************************/
+
+
+    /**
+     * Find a free pattern slot
+     *
+     * @return slot, or NULL if all slots are used
+     */
+PCA9622Blink *PCA9622Blinker::freeSlot() {
+
+  for (uint16_t i = 0; i < _numBlinks; i++) {
+    if (_blinks[i].device == NULL) {
+      return &_blinks[i];
+    }
+  }
+
+  return NULL;
+}
+
+    /**
+     * Find the hardware pattern of a device
+     *
+     * @return slot, or NULL if the device doesn't blink in hardware
+     */
+PCA9622Blink *PCA9622Blinker::hardwareSlot(PCA9622 *device) {
+
+  for (uint16_t i = 0; i < _numBlinks; i++) {
+    if (_blinks[i].device == device && _blinks[i].hardware) {
+      return &_blinks[i];
+    }
+  }
+
+  return NULL;
+}
+
+    /**
+     * Remove channels from their patterns without flushing, see stop()
+     *
+     * @param device   PCA9622 of the channels
+     * @param channels Bit n set for channel n (REG_PWM0 + n)
+     */
+void PCA9622Blinker::release(PCA9622 *device, uint16_t channels) {
+
+  for (uint16_t i = 0; i < _numBlinks; i++) {
+    PCA9622Blink &blink = _blinks[i];
+
+    if (blink.device != device || (blink.channels & channels) == 0) {
+      continue;
+    }
+
+    device->setLdrStates(blink.channels & channels, LDR_STATE_IND);
+    blink.channels &= ~channels;
+
+    if (blink.channels == 0) {
+      if (blink.hardware) {
+        // Hand the group control back for dimming, at full brightness
+        device->setGroupControlMode(GROUP_CONTROL_MODE_DIMMING);
+        device->setGrpPwm(0xFF);
+      }
+      blink.device = NULL;
+    }
+  }
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef PCA9622_BLINKER_H
+#define PCA9622_BLINKER_H
+
+#include "PCA9622.h"
+
+// Result of PCA9622Blinker::blink()
+#define BLINK_FAILED   0 // No pattern slot free
+#define BLINK_HARDWARE 1 // Pattern runs on the chip, no further bus traffic
+#define BLINK_SOFTWARE 2 // Pattern is toggled by PCA9622Blinker::tick()
+
+/**
+ * One blink pattern on a set of channels of a device. Provided by the
+ * application as an array, see PCA9622Blinker
+ */
+struct PCA9622Blink {
+    PCA9622 *device;   // Device of the channels, NULL if the slot is free
+    uint16_t channels; // Bit n set for channel n (REG_PWM0 + n)
+    uint16_t period;   // Period in ms
+    uint16_t onTime;   // On time per period in ms
+    uint32_t start;    // Start time in ms, software patterns only
+    bool hardware;     // Pattern runs on the chip's group blinking
+    bool on;           // Channels currently on, software patterns only
+};
+
+/**
+ * Runs blink patterns given as period and on time. A pattern is offloaded
+ * to the group blinking of the chip (GRPFREQ, GRPPWM, LDR_STATE_IND_GRP)
+ * whenever possible, which costs no bus traffic after it has been set up.
+ * Each chip has a single blink generator, so it is shared by all patterns
+ * with the same register values. Patterns that can't be expressed in
+ * hardware fall back to toggling the LED driver output states in tick().
+ *
+ * The planner owns the group control of the devices it blinks in hardware:
+ * group dimming is not available on them while a hardware pattern runs
+ */
+class PCA9622Blinker {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Constructor for PCA9622Blinker
+     *
+     * @param blinks    Array of pattern slots. Must stay valid for the
+     *                  lifetime of the planner
+     * @param numBlinks Number of pattern slots
+     */
+    PCA9622Blinker(PCA9622Blink *blinks, uint16_t numBlinks);
+
+    /**
+     * Start blinking channels. Patterns already running on any of the
+     * channels are stopped. An on time of 0 turns the channels off, an on
+     * time of at least the period turns them on, both without a pattern slot
+     *
+     * @param device   PCA9622 of the channels
+     * @param channels Bit n set for channel n (REG_PWM0 + n)
+     * @param periodMs Period in milliseconds
+     * @param onTimeMs On time per period in milliseconds
+     * @param now      Current time in milliseconds, e.g. millis()
+     *
+     * @return BLINK_HARDWARE, BLINK_SOFTWARE or BLINK_FAILED
+     */
+    uint8_t blink(PCA9622 *device, uint16_t channels, uint16_t periodMs, uint16_t onTimeMs, uint32_t now);
+
+    /**
+     * Stop blinking channels and leave them on with their individual
+     * brightness (LDR_STATE_IND)
+     *
+     * @param device   PCA9622 of the channels
+     * @param channels Bit n set for channel n (REG_PWM0 + n)
+     */
+    void stop(PCA9622 *device, uint16_t channels);
+
+    /**
+     * Toggle the channels of software patterns. Writes only when a pattern
+     * changes state, hardware patterns never cause traffic here
+     *
+     * @param now Current time in milliseconds, e.g. millis()
+     */
+    void tick(uint32_t now);
+
+    /**
+     * @return number of patterns running in software
+     */
+    uint16_t softwarePatterns();
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+    /**
+     * Find a free pattern slot
+     *
+     * @return slot, or NULL if all slots are used
+     */
+    PCA9622Blink *freeSlot();
+
+    /**
+     * Find the hardware pattern of a device
+     *
+     * @return slot, or NULL if the device doesn't blink in hardware
+     */
+    PCA9622Blink *hardwareSlot(PCA9622 *device);
+
+    /**
+     * Remove channels from their patterns without flushing, see stop()
+     */
+    void release(PCA9622 *device, uint16_t channels);
+
+    PCA9622Blink *_blinks;
+    uint16_t _numBlinks;
+};
+#endif //PCA9622_BLINKER_H
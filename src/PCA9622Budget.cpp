@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#include "PCA9622Budget.h"
+
+// SCL cycles of a write transfer besides its data bytes: START, address
+// byte, control byte and STOP
+#define TRANSFER_CYCLES (1 + 9 + 9 + 1)
+#define BYTE_CYCLES     9
+
+/******************************* PUBLIC METHODS *******************************/
+
+
+    /**
+     * Constructor for PCA9622Budget
+     *
+     * @param clock Bus clock in Hz (see PCA9622_CLOCK_*)
+     */
+PCA9622Budget::PCA9622Budget(uint32_t clock) {
+
+  _clock = clock;
+
+  _numDevices = 0;
+  _transfers = 0;
+  _bytes = 0;
+
+  setLimit(0, 100, BUDGET_POLICY_WARN);
+}
+
+    /**
+     * Add a device on the bus with its update pattern
+     *
+     * @param device    PCA9622 on the bus, used for runtime measurement. May
+     *                  be NULL for sizing only
+     * @param transfers Transfers per frame
+     * @param bytes     Data bytes per frame, summed over all transfers
+     *
+     * @return false if PCA9622_BUDGET_MAX_DEVICES are already added
+     */
+bool PCA9622Budget::addDevice(PCA9622 *device, uint8_t transfers, uint16_t bytes) {
+
+  if (_numDevices >= PCA9622_BUDGET_MAX_DEVICES) {
+    return false;
+  }
+
+  _devices[_numDevices++] = device;
+  _transfers += transfers;
+  _bytes += bytes;
+
+  // Bus time the device spent before it was added is not part of the next frame
+  if (device != NULL) {
+    _lastBusMicros += device->getStats().busMicros;
+  }
+
+  return true;
+}
+
+    /**
+     * Bus time of write transfers, including START, address byte, control
+     * byte, STOP and the bus free time before the next START
+     *
+     * @param clock     Bus clock in Hz
+     * @param transfers Number of transfers
+     * @param bytes     Data bytes, summed over all transfers
+     *
+     * @return bus time in microseconds
+     */
+uint32_t PCA9622Budget::transferMicros(uint32_t clock, uint16_t transfers, uint32_t bytes) {
+
+  uint32_t cycles = (uint32_t) transfers * TRANSFER_CYCLES + bytes * BYTE_CYCLES;
+  uint32_t kiloHertz = clock / 1000;
+
+  // Bus free time between STOP and START, tBUF
+  uint16_t freeNanos = (clock > PCA9622_CLOCK_FAST) ? 500 : (clock > PCA9622_CLOCK_STANDARD) ? 1300 : 4700;
+
+  if (kiloHertz == 0) {
+    return 0xFFFFFFFF;
+  }
+
+  return (cycles * 1000 + kiloHertz - 1) / kiloHertz + ((uint32_t) transfers * freeNanos + 999) / 1000;
+}
+
+    /**
+     * @return bus time of one frame of all devices in microseconds
+     */
+uint32_t PCA9622Budget::frameMicros() {
+
+  return transferMicros(_clock, _transfers, _bytes);
+}
+
+    /**
+     * @return frames per second the bus can carry at full utilization
+     */
+uint16_t PCA9622Budget::maxFps() {
+
+  uint32_t micros = frameMicros();
+
+  if (micros == 0) {
+    return 0xFFFF;
+  }
+
+  uint32_t fps = 1000000UL / micros;
+
+  return (fps > 0xFFFF) ? 0xFFFF : fps;
+}
+
+    /**
+     * Bus utilization at a given frame rate
+     *
+     * @param fps Frames per second
+     *
+     * @return utilization in percent, above 100 if the bus can't keep up
+     */
+uint16_t PCA9622Budget::utilization(uint16_t fps) {
+
+  uint32_t percent = (frameMicros() * fps + 5000) / 10000;
+
+  return (percent > 0xFFFF) ? 0xFFFF : percent;
+}
+
+    /**
+     * Set the budget for runtime checks
+     *
+     * @param fps            Frames per second the application renders
+     * @param maxUtilization Share of the bus a frame may take, in percent
+     * @param policy         BUDGET_POLICY_WARN or BUDGET_POLICY_THROTTLE
+     */
+void PCA9622Budget::setLimit(uint16_t fps, uint8_t maxUtilization, uint8_t policy) {
+
+  _fps = fps;
+  _maxUtilization = (maxUtilization > 0) ? maxUtilization : 1;
+  _policy = policy;
+
+  _lastBusMicros = busMicros();
+  _lastFrameMicros = 0;
+  _frameStart = 0;
+  _nextFrame = 0;
+  _overruns = 0;
+}
+
+    /**
+     * Check whether the next frame may be rendered. Always true with
+     * BUDGET_POLICY_WARN. With BUDGET_POLICY_THROTTLE, false until the
+     * previous frame's bus time fits into maxUtilization of the elapsed time
+     *
+     * @param now Current time in microseconds, e.g. micros()
+     *
+     * @return true to render a frame now
+     */
+bool PCA9622Budget::frameDue(uint32_t now) {
+
+  if (_policy == BUDGET_POLICY_THROTTLE && (int32_t) (now - _nextFrame) < 0) {
+    return false;
+  }
+
+  _frameStart = now;
+
+  return true;
+}
+
+    /**
+     * Report that a frame was sent. Measures its bus time from the statistics
+     * of the devices
+     */
+void PCA9622Budget::frameDone() {
+
+  uint32_t total = busMicros();
+
+  _lastFrameMicros = total - _lastBusMicros;
+  _lastBusMicros = total;
+
+  // Time the frame may take on the bus, and the interval it then needs
+  uint32_t interval = (_fps > 0) ? 1000000UL / _fps : 0;
+  uint32_t needed = (uint32_t) ((uint64_t) _lastFrameMicros * 100 / _maxUtilization);
+
+  if (_fps > 0 && needed > interval) {
+    _overruns++;
+  }
+
+  if (_policy == BUDGET_POLICY_THROTTLE) {
+    _nextFrame = _frameStart + ((needed > interval) ? needed : interval);
+  }
+}
+
+    /**
+     * @return bus time of the last frame in microseconds, as measured
+     */
+uint32_t PCA9622Budget::lastFrameMicros() {
+
+  return _lastFrameMicros;
+}
+
+    /**
+     * @return frames that exceeded the budget since setLimit()
+     */
+uint16_t PCA9622Budget::overruns() {
+
+  return _overruns;
+}
+
+/****************************** PRIVATE METHODS *******************************/
+
+
+    /**
+     * @return bus time of all devices from their statistics, in microseconds
+     */
+uint32_t PCA9622Budget::busMicros() {
+
+  uint32_t total = 0;
+
+  for (uint8_t i = 0; i < _numDevices; i++) {
+    if (_devices[i] != NULL) {
+      total += _devices[i]->getStats().busMicros;
+    }
+  }
+
+  return total;
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef PCA9622_BUDGET_H
+#define PCA9622_BUDGET_H
+
+#include "PCA9622.h"
+
+#define PCA9622_BUDGET_MAX_DEVICES 16 // Devices per bus
+
+// Reaction when a frame exceeds the budget, see PCA9622Budget::setLimit()
+#define BUDGET_POLICY_WARN     0 // Count the overrun, see overruns()
+#define BUDGET_POLICY_THROTTLE 1 // Count the overrun and delay the next frame
+
+/**
+ * Bandwidth budget of one I2C bus. Before deployment, it computes from the
+ * devices on the bus, their update pattern and the bus clock how many frames
+ * per second the bus can carry. At runtime, it measures the bus time of each
+ * frame from the device statistics and warns or throttles when a frame
+ * takes more of the bus than allowed.
+ *
+ * The update pattern of a device is given as transfers and data bytes per
+ * frame, e.g. 1 transfer of 16 bytes for setAllPwm() or commitFrame() of all
+ * channels, or 16 transfers of 1 byte for 16 separate setPwm() calls
+ */
+class PCA9622Budget {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Constructor for PCA9622Budget
+     *
+     * @param clock Bus clock in Hz (see PCA9622_CLOCK_*)
+     */
+    PCA9622Budget(uint32_t clock);
+
+    /**
+     * Add a device on the bus with its update pattern
+     *
+     * @param device    PCA9622 on the bus, used for runtime measurement. May
+     *                  be NULL for sizing only
+     * @param transfers Transfers per frame
+     * @param bytes     Data bytes per frame, summed over all transfers
+     *
+     * @return false if PCA9622_BUDGET_MAX_DEVICES are already added
+     */
+    bool addDevice(PCA9622 *device, uint8_t transfers, uint16_t bytes);
+
+    /**
+     * Bus time of write transfers, including START, address byte, control
+     * byte, STOP and the bus free time before the next START
+     *
+     * @param clock     Bus clock in Hz
+     * @param transfers Number of transfers
+     * @param bytes     Data bytes, summed over all transfers
+     *
+     * @return bus time in microseconds
+     */
+    static uint32_t transferMicros(uint32_t clock, uint16_t transfers, uint32_t bytes);
+
+    /**
+     * @return bus time of one frame of all devices in microseconds
+     */
+    uint32_t frameMicros();
+
+    /**
+     * @return frames per second the bus can carry at full utilization
+     */
+    uint16_t maxFps();
+
+    /**
+     * Bus utilization at a given frame rate
+     *
+     * @param fps Frames per second
+     *
+     * @return utilization in percent, above 100 if the bus can't keep up
+     */
+    uint16_t utilization(uint16_t fps);
+
+    /**
+     * Set the budget for runtime checks
+     *
+     * @param fps            Frames per second the application renders
+     * @param maxUtilization Share of the bus a frame may take, in percent
+     * @param policy         BUDGET_POLICY_WARN or BUDGET_POLICY_THROTTLE
+     */
+    void setLimit(uint16_t fps, uint8_t maxUtilization, uint8_t policy);
+
+    /**
+     * Check whether the next frame may be rendered. Always true with
+     * BUDGET_POLICY_WARN. With BUDGET_POLICY_THROTTLE, false until the
+     * previous frame's bus time fits into maxUtilization of the elapsed time
+     *
+     * @param now Current time in microseconds, e.g. micros()
+     *
+     * @return true to render a frame now
+     */
+    bool frameDue(uint32_t now);
+
+    /**
+     * Report that a frame was sent. Measures its bus time from the statistics
+     * of the devices
+     */
+    void frameDone();
+
+    /**
+     * @return bus time of the last frame in microseconds, as measured
+     */
+    uint32_t lastFrameMicros();
+
+    /**
+     * @return frames that exceeded the budget since setLimit()
+     */
+    uint16_t overruns();
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+    /**
+     * @return bus time of all devices from their statistics, in microseconds
+     */
+    uint32_t busMicros();
+
+    uint32_t _clock;
+
+    PCA9622 *_devices[PCA9622_BUDGET_MAX_DEVICES];
+    uint8_t _numDevices;
+    uint16_t _transfers;
+    uint32_t _bytes;
+
+    uint16_t _fps;
+    uint8_t _maxUtilization;
+    uint8_t _policy;
+
+    uint32_t _lastBusMicros;
+    uint32_t _lastFrameMicros;
+    uint32_t _frameStart;
+    uint32_t _nextFrame;
+    uint16_t _overruns;
+};
+#endif //PCA9622_BUDGET_H
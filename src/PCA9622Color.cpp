@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#include "PCA9622Color.h"
+
+#if defined(__AVR__)
+  #include <avr/pgmspace.h>
+  #define COLOR_READ(table, index) pgm_read_byte(&(table)[index])
+#else
+  #ifndef PROGMEM
+    #define PROGMEM
+  #endif
+  #define COLOR_READ(table, index) ((table)[index])
+#endif
+
+#define KELVIN_STEP 500
+
+// Black body colors from PCA9622_KELVIN_MIN to PCA9622_KELVIN_MAX in steps of KELVIN_STEP
+static const uint8_t temperatureTable[][3] PROGMEM = {
+  { 255,  68,   0 }, //  1000 K
+  { 255, 108,   0 }, //  1500 K
+  { 255, 137,  14 }, //  2000 K
+  { 255, 159,  70 }, //  2500 K
+  { 255, 177, 110 }, //  3000 K
+  { 255, 193, 141 }, //  3500 K
+  { 255, 206, 166 }, //  4000 K
+  { 255, 218, 187 }, //  4500 K
+  { 255, 228, 206 }, //  5000 K
+  { 255, 237, 222 }, //  5500 K
+  { 255, 246, 237 }, //  6000 K
+  { 255, 254, 250 }, //  6500 K
+  { 243, 242, 255 }, //  7000 K
+  { 230, 235, 255 }, //  7500 K
+  { 221, 230, 255 }, //  8000 K
+  { 215, 226, 255 }, //  8500 K
+  { 210, 223, 255 }, //  9000 K
+  { 205, 220, 255 }, //  9500 K
+  { 202, 218, 255 }, // 10000 K
+  { 199, 216, 255 }, // 10500 K
+  { 196, 214, 255 }, // 11000 K
+  { 193, 213, 255 }, // 11500 K
+  { 191, 211, 255 }, // 12000 K
+};
+
+/******************************* PUBLIC METHODS *******************************/
+
+
+    /**
+     * Convert a color from HSV to RGB
+     *
+     * @param hsv Color in HSV
+     * @param rgb Red, green and blue value
+     */
+void PCA9622Color::hsvToRgb(const PCA9622Hsv &hsv, uint8_t *rgb) {
+
+  uint16_t hue = hsv.hue % PCA9622_HUE_MAX;
+  uint8_t sector = hue >> 8;
+  uint8_t fraction = hue & 0xFF;
+
+  uint8_t p = scale(hsv.val, 255 - hsv.sat);
+  uint8_t q = scale(hsv.val, 255 - scale(hsv.sat, fraction));
+  uint8_t t = scale(hsv.val, 255 - scale(hsv.sat, 255 - fraction));
+
+  switch (sector) {
+    case 0:  rgb[0] = hsv.val; rgb[1] = t;       rgb[2] = p;       break;
+    case 1:  rgb[0] = q;       rgb[1] = hsv.val; rgb[2] = p;       break;
+    case 2:  rgb[0] = p;       rgb[1] = hsv.val; rgb[2] = t;       break;
+    case 3:  rgb[0] = p;       rgb[1] = q;       rgb[2] = hsv.val; break;
+    case 4:  rgb[0] = t;       rgb[1] = p;       rgb[2] = hsv.val; break;
+    default: rgb[0] = hsv.val; rgb[1] = p;       rgb[2] = q;       break;
+  }
+}
+
+    /**
+     * Convert a color from RGB to RGBW. The common part of red, green and
+     * blue moves to the white channel
+     *
+     * @param rgb  Red, green and blue value
+     * @param rgbw Red, green, blue and white value
+     */
+void PCA9622Color::rgbToRgbw(const uint8_t *rgb, uint8_t *rgbw) {
+
+  uint8_t w = rgb[0];
+
+  if (rgb[1] < w) {
+    w = rgb[1];
+  }
+
+  if (rgb[2] < w) {
+    w = rgb[2];
+  }
+
+  rgbw[0] = rgb[0] - w;
+  rgbw[1] = rgb[1] - w;
+  rgbw[2] = rgb[2] - w;
+  rgbw[3] = w;
+}
+
+    /**
+     * Convert a color from RGB to RGBW for a white channel with a given
+     * color. As much as possible of the color moves to the white channel
+     *
+     * @param rgb   Red, green and blue value
+     * @param rgbw  Red, green, blue and white value
+     * @param white Color of the white channel
+     */
+void PCA9622Color::rgbToRgbw(const uint8_t *rgb, uint8_t *rgbw, const PCA9622WhitePoint &white) {
+
+  const uint8_t channel[3] = { white.r, white.g, white.b };
+  uint16_t w = 255;
+
+  // Largest white value that none of the color channels falls below
+  for (uint8_t c = 0; c < 3; c++) {
+    if (channel[c] > 0) {
+      uint16_t limit = (uint16_t) rgb[c] * 255 / channel[c];
+
+      if (limit < w) {
+        w = limit;
+      }
+    }
+  }
+
+  for (uint8_t c = 0; c < 3; c++) {
+    uint8_t part = scale(w, channel[c]);
+
+    rgbw[c] = (rgb[c] > part) ? rgb[c] - part : 0;
+  }
+
+  rgbw[3] = w;
+}
+
+    /**
+     * Convert a color temperature to RGB
+     *
+     * @param kelvin Color temperature, PCA9622_KELVIN_MIN to PCA9622_KELVIN_MAX
+     * @param rgb    Red, green and blue value
+     */
+void PCA9622Color::temperatureToRgb(uint16_t kelvin, uint8_t *rgb) {
+
+  if (kelvin < PCA9622_KELVIN_MIN) {
+    kelvin = PCA9622_KELVIN_MIN;
+  }
+  else if (kelvin > PCA9622_KELVIN_MAX) {
+    kelvin = PCA9622_KELVIN_MAX;
+  }
+
+  uint8_t index = (kelvin - PCA9622_KELVIN_MIN) / KELVIN_STEP;
+  uint16_t fraction = (kelvin - PCA9622_KELVIN_MIN) % KELVIN_STEP;
+  uint8_t next = (fraction > 0) ? index + 1 : index;
+
+  // Linear interpolation between the table entries
+  for (uint8_t c = 0; c < 3; c++) {
+    int16_t from = COLOR_READ(temperatureTable[index], c);
+    int16_t to = COLOR_READ(temperatureTable[next], c);
+
+    rgb[c] = from + (int16_t) (((int32_t) (to - from) * fraction + KELVIN_STEP / 2) / KELVIN_STEP);
+  }
+}
+
+    /**
+     * Convert a color temperature to RGBW for a white channel with a given
+     * color
+     *
+     * @param kelvin Color temperature, PCA9622_KELVIN_MIN to PCA9622_KELVIN_MAX
+     * @param rgbw   Red, green, blue and white value
+     * @param white  Color of the white channel
+     */
+void PCA9622Color::temperatureToRgbw(uint16_t kelvin, uint8_t *rgbw, const PCA9622WhitePoint &white) {
+
+  uint8_t rgb[3];
+
+  temperatureToRgb(kelvin, rgb);
+  rgbToRgbw(rgb, rgbw, white);
+}
+
+    /**
+     * Convert an array of colors from HSV to RGB
+     *
+     * @param hsv   Colors in HSV
+     * @param rgb   Array of 3 * count bytes for red, green and blue values
+     * @param count Number of colors
+     */
+void PCA9622Color::hsvToRgb(const PCA9622Hsv *hsv, uint8_t *rgb, uint16_t count) {
+
+  for (uint16_t i = 0; i < count; i++) {
+    hsvToRgb(hsv[i], &rgb[3 * i]);
+  }
+}
+
+    /**
+     * Convert an array of colors from RGB to RGBW, see rgbToRgbw()
+     *
+     * @param rgb   Array of 3 * count bytes with red, green and blue values
+     * @param rgbw  Array of 4 * count bytes for red, green, blue and white values
+     * @param count Number of colors
+     */
+void PCA9622Color::rgbToRgbw(const uint8_t *rgb, uint8_t *rgbw, uint16_t count) {
+
+  for (uint16_t i = 0; i < count; i++) {
+    rgbToRgbw(&rgb[3 * i], &rgbw[4 * i]);
+  }
+}
+
+    /**
+     * Convert an array of colors from RGB to RGBW for a white channel with
+     * a given color
+     *
+     * @param rgb   Array of 3 * count bytes with red, green and blue values
+     * @param rgbw  Array of 4 * count bytes for red, green, blue and white values
+     * @param count Number of colors
+     * @param white Color of the white channel
+     */
+void PCA9622Color::rgbToRgbw(const uint8_t *rgb, uint8_t *rgbw, uint16_t count, const PCA9622WhitePoint &white) {
+
+  for (uint16_t i = 0; i < count; i++) {
+    rgbToRgbw(&rgb[3 * i], &rgbw[4 * i], white);
+  }
+}
+
+/****************************** PRIVATE METHODS *******************************/
+
+
+    /**
+     * a * b / 255, rounded
+     */
+uint8_t PCA9622Color::scale(uint8_t a, uint8_t b) {
+
+  uint16_t product = (uint16_t) a * b + 128;
+
+  return (product + (product >> 8)) >> 8;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef PCA9622_COLOR_H
+#define PCA9622_COLOR_H
+
+#include <Arduino.h>
+
+#define PCA9622_HUE_MAX 1536 // Hue range, 256 steps per sector of the color wheel
+
+#define PCA9622_KELVIN_MIN 1000  // Lowest color temperature of temperatureToRgb()
+#define PCA9622_KELVIN_MAX 12000 // Highest color temperature of temperatureToRgb()
+
+/**
+ * Color in HSV
+ */
+struct PCA9622Hsv {
+    uint16_t hue; // 0 to PCA9622_HUE_MAX - 1, 0 = red, 512 = green, 1024 = blue
+    uint8_t sat;  // Saturation
+    uint8_t val;  // Value (brightness)
+};
+
+/**
+ * Color of the white channel at full brightness, expressed in the PWM
+ * values of the red, green and blue channels that produce the same color
+ */
+struct PCA9622WhitePoint {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+};
+
+/**
+ * Integer color space conversions. Pixels are stored as 3 (RGB) or 4 (RGBW)
+ * consecutive bytes, so converted arrays can be passed to
+ * PCA9622::setPwmRange() when the color channels use adjacent registers
+ */
+class PCA9622Color {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Convert a color from HSV to RGB
+     *
+     * @param hsv Color in HSV
+     * @param rgb Red, green and blue value
+     */
+    static void hsvToRgb(const PCA9622Hsv &hsv, uint8_t *rgb);
+
+    /**
+     * Convert a color from RGB to RGBW. The common part of red, green and
+     * blue moves to the white channel
+     *
+     * @param rgb  Red, green and blue value
+     * @param rgbw Red, green, blue and white value
+     */
+    static void rgbToRgbw(const uint8_t *rgb, uint8_t *rgbw);
+
+    /**
+     * Convert a color from RGB to RGBW for a white channel with a given
+     * color. As much as possible of the color moves to the white channel
+     *
+     * @param rgb   Red, green and blue value
+     * @param rgbw  Red, green, blue and white value
+     * @param white Color of the white channel
+     */
+    static void rgbToRgbw(const uint8_t *rgb, uint8_t *rgbw, const PCA9622WhitePoint &white);
+
+    /**
+     * Convert a color temperature to RGB
+     *
+     * @param kelvin Color temperature, PCA9622_KELVIN_MIN to PCA9622_KELVIN_MAX
+     * @param rgb    Red, green and blue value
+     */
+    static void temperatureToRgb(uint16_t kelvin, uint8_t *rgb);
+
+    /**
+     * Convert a color temperature to RGBW for a white channel with a given
+     * color
+     *
+     * @param kelvin Color temperature, PCA9622_KELVIN_MIN to PCA9622_KELVIN_MAX
+     * @param rgbw   Red, green, blue and white value
+     * @param white  Color of the white channel
+     */
+    static void temperatureToRgbw(uint16_t kelvin, uint8_t *rgbw, const PCA9622WhitePoint &white);
+
+    /**
+     * Convert an array of colors from HSV to RGB
+     *
+     * @param hsv   Colors in HSV
+     * @param rgb   Array of 3 * count bytes for red, green and blue values
+     * @param count Number of colors
+     */
+    static void hsvToRgb(const PCA9622Hsv *hsv, uint8_t *rgb, uint16_t count);
+
+    /**
+     * Convert an array of colors from RGB to RGBW, see rgbToRgbw()
+     *
+     * @param rgb   Array of 3 * count bytes with red, green and blue values
+     * @param rgbw  Array of 4 * count bytes for red, green, blue and white values
+     * @param count Number of colors
+     */
+    static void rgbToRgbw(const uint8_t *rgb, uint8_t *rgbw, uint16_t count);
+
+    /**
+     * Convert an array of colors from RGB to RGBW for a white channel with
+     * a given color
+     *
+     * @param rgb   Array of 3 * count bytes with red, green and blue values
+     * @param rgbw  Array of 4 * count bytes for red, green, blue and white values
+     * @param count Number of colors
+     * @param white Color of the white channel
+     */
+    static void rgbToRgbw(const uint8_t *rgb, uint8_t *rgbw, uint16_t count, const PCA9622WhitePoint &white);
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+    /**
+     * a * b / 255, rounded
+     */
+    static uint8_t scale(uint8_t a, uint8_t b);
+};
+#endif //PCA9622_COLOR_H
@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#include "PCA9622FrameBuffer.h"
+
+/******************************* PUBLIC METHODS *******************************/
+
+
+    /**
+     * Constructor for PCA9622FrameBuffer
+     *
+     * @param devices    Array of initialized devices. Must stay valid for the
+     *                   lifetime of the frame buffer
+     * @param numDevices Number of devices
+     * @param buffer     Frame buffer of 16 * numDevices bytes
+     */
+PCA9622FrameBuffer::PCA9622FrameBuffer(PCA9622 **devices, uint8_t numDevices, uint8_t *buffer) {
+
+  _devices = devices;
+  _numDevices = numDevices;
+  _buffer = buffer;
+
+  _pixels = NULL;
+  _numPixels = 0;
+
+  _lastCommitMicros = 0;
+  _maxCommitMicros = 0;
+
+#if !defined(ARDUINO)
+  _numBuses = 0;
+  _numWorkers = 0;
+  _busy = 0;
+  _frame = 0;
+  _stop = false;
+#endif
+}
+
+#if !defined(ARDUINO)
+    /**
+     * Destructor for PCA9622FrameBuffer. Stops the bus workers
+     */
+PCA9622FrameBuffer::~PCA9622FrameBuffer() {
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _stop = true;
+  }
+  _frameStart.notify_all();
+
+  for (uint8_t b = 1; b < _numWorkers; b++) {
+    _workers[b].join();
+  }
+}
+#endif
+
+    /**
+     * Set the mapping of logical pixels to devices and registers
+     *
+     * @param pixels    Array of pixels. Must stay valid for the lifetime of
+     *                  the frame buffer
+     * @param numPixels Number of pixels
+     */
+void PCA9622FrameBuffer::setPixelMap(const PCA9622Pixel *pixels, uint16_t numPixels) {
+
+  _pixels = pixels;
+  _numPixels = numPixels;
+}
+
+    /**
+     * Set a logical RGB pixel
+     *
+     * @param pixel Index of the pixel in the pixel map
+     * @param r     Value for red color channel
+     * @param g     Value for green color channel
+     * @param b     Value for blue color channel
+     */
+void PCA9622FrameBuffer::setPixel(uint16_t pixel, uint8_t r, uint8_t g, uint8_t b) {
+
+  if (pixel >= _numPixels) {
+    return;
+  }
+
+  const PCA9622Pixel &p = _pixels[pixel];
+
+  setChannel(p.device, p.regRedPwm, r);
+  setChannel(p.device, p.regGreenPwm, g);
+  setChannel(p.device, p.regBluePwm, b);
+}
+
+    /**
+     * Set a single channel
+     *
+     * @param device Index of the device
+     * @param regPwm Register address for PWM channel
+     * @param pwm    PWM value
+     */
+void PCA9622FrameBuffer::setChannel(uint8_t device, uint8_t regPwm, uint8_t pwm) {
+
+  if (device < _numDevices && regPwm >= REG_PWM0 && regPwm <= REG_PWM15) {
+    _buffer[16 * device + regPwm - REG_PWM0] = pwm;
+  }
+}
+
+    /**
+     * Direct access to the frame buffer, 16 PWM values per device
+     *
+     * @return frame buffer
+     */
+uint8_t *PCA9622FrameBuffer::getBuffer() {
+
+  return _buffer;
+}
+
+    /**
+     * Set all channels to 0
+     */
+void PCA9622FrameBuffer::clear() {
+
+  memset(_buffer, 0, 16 * _numDevices);
+}
+
+    /**
+     * Send the frame to all devices. On a device in deferred mode, the frame
+     * is only staged until its next flush()
+     */
+void PCA9622FrameBuffer::commit() {
+
+#if !defined(ARDUINO)
+  std::unique_lock<std::mutex> lock(_mutex);
+  uint8_t numBuses = 0;
+  bool overflow = false;
+
+  for (uint8_t i = 0; i < _numDevices; i++) {
+    if (findBus(_buses, numBuses, _devices[i]->_wire) < numBuses) {
+      continue;
+    }
+
+    if (numBuses < PCA9622_FRAMEBUFFER_MAX_BUSES) {
+      _buses[numBuses++] = _devices[i]->_wire;
+    }
+    else {
+      overflow = true;
+    }
+  }
+
+  // Workers are started once and kept for the following frames
+  for (uint8_t b = (_numWorkers > 1) ? _numWorkers : 1; b < numBuses; b++) {
+    _workers[b] = std::thread(&PCA9622FrameBuffer::runWorker, this, b, _frame);
+    _numWorkers = b + 1;
+  }
+
+  _numBuses = numBuses;
+  _busy = (numBuses > 1) ? numBuses - 1 : 0;
+  _frame++;
+  lock.unlock();
+  _frameStart.notify_all();
+
+  uint32_t longest = (numBuses > 0) ? commitBus(_buses[0]) : 0;
+
+  // Devices on buses without a worker are committed one by one on this thread
+  for (uint8_t i = 0; i < _numDevices && overflow; i++) {
+    TwoWire *wire = _devices[i]->_wire;
+
+    if (findBus(_buses, numBuses, wire) == numBuses) {
+      uint64_t busStart = wire->stats().busTimeNs;
+
+      stageDevice(i);
+      _devices[i]->wait(_devices[i]->lastToken());
+      longest += (wire->stats().busTimeNs - busStart) / 1000;
+    }
+  }
+
+  lock.lock();
+  _frameDone.wait(lock, [this] { return _busy == 0; });
+
+  for (uint8_t b = 1; b < numBuses; b++) {
+    if (_busMicros[b] > longest) {
+      longest = _busMicros[b];
+    }
+  }
+
+  // The simulated clock adds up the buses, the bus time of the slowest thread is the latency
+  _lastCommitMicros = longest;
+#else
+  uint32_t start = micros();
+
+  for (uint8_t i = 0; i < _numDevices; i++) {
+    stageDevice(i);
+  }
+
+  // Devices with a queue: one transfer per device and round, so the
+  // transfers of different buses are interleaved
+  bool pending = true;
+
+  while (pending) {
+    pending = false;
+
+    for (uint8_t i = 0; i < _numDevices; i++) {
+      pending |= _devices[i]->poll();
+    }
+  }
+
+  _lastCommitMicros = micros() - start;
+#endif
+
+  if (_lastCommitMicros > _maxCommitMicros) {
+    _maxCommitMicros = _lastCommitMicros;
+  }
+}
+
+    /**
+     * @return duration of the last commit() in microseconds. On a host, the
+     *         bus time of the slowest bus thread
+     */
+uint32_t PCA9622FrameBuffer::lastCommitMicros() {
+
+  return _lastCommitMicros;
+}
+
+    /**
+     * @return longest duration of commit() in microseconds since construction
+     */
+uint32_t PCA9622FrameBuffer::maxCommitMicros() {
+
+  return _maxCommitMicros;
+}
+
+/****************************** PRIVATE METHODS *******************************/
+
+
+    /**
+     * Stage the buffer of a device and flush it to the device or its queue.
+     * A device in deferred mode is not flushed
+     *
+     * @param device Index of the device
+     */
+void PCA9622FrameBuffer::stageDevice(uint8_t device) {
+
+  PCA9622 *pca9622 = _devices[device];
+  bool wasDeferred = pca9622->isDeferred();
+
+  pca9622->setDeferred(true);
+  pca9622->setAllPwm(&_buffer[16 * device]);
+
+  // A device that was already deferred keeps the frame staged for the caller's flush
+  if (!wasDeferred) {
+    pca9622->setDeferred(false);
+  }
+}
+
+#if !defined(ARDUINO)
+    /**
+     * Find a bus in a list of buses
+     *
+     * @param buses    List of buses
+     * @param numBuses Number of buses in the list
+     * @param wire     Bus to find
+     *
+     * @return index of wire in buses, numBuses if not found
+     */
+uint8_t PCA9622FrameBuffer::findBus(TwoWire *const *buses, uint8_t numBuses, TwoWire *wire) {
+
+  uint8_t b = 0;
+
+  while (b < numBuses && buses[b] != wire) {
+    b++;
+  }
+
+  return b;
+}
+
+    /**
+     * Commit all devices of one bus and wait until they are sent
+     *
+     * @param wire Bus to commit
+     *
+     * @return bus time of the commit in microseconds
+     */
+uint32_t PCA9622FrameBuffer::commitBus(TwoWire *wire) {
+
+  uint64_t busStart = wire->stats().busTimeNs;
+
+  for (uint8_t i = 0; i < _numDevices; i++) {
+    if (_devices[i]->_wire == wire) {
+      stageDevice(i);
+      _devices[i]->wait(_devices[i]->lastToken());
+    }
+  }
+
+  return (wire->stats().busTimeNs - busStart) / 1000;
+}
+
+    /**
+     * Worker of one bus: commits the bus for every new frame until the frame
+     * buffer is destroyed
+     *
+     * @param bus   Index of the bus
+     * @param frame Last frame already committed when the worker starts
+     */
+void PCA9622FrameBuffer::runWorker(uint8_t bus, uint32_t frame) {
+
+  std::unique_lock<std::mutex> lock(_mutex);
+
+  for (;;) {
+    _frameStart.wait(lock, [this, frame] { return _stop || _frame != frame; });
+
+    if (_stop) {
+      return;
+    }
+
+    frame = _frame;
+
+    // Not needed for this frame, the devices moved to other buses
+    if (bus >= _numBuses) {
+      continue;
+    }
+
+    TwoWire *wire = _buses[bus];
+
+    lock.unlock();
+    uint32_t busMicros = commitBus(wire);
+    lock.lock();
+
+    _busMicros[bus] = busMicros;
+
+    if (--_busy == 0) {
+      _frameDone.notify_one();
+    }
+  }
+}
+#endif
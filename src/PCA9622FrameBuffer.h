@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef PCA9622_FRAMEBUFFER_H
+#define PCA9622_FRAMEBUFFER_H
+
+#include "PCA9622.h"
+
+#if !defined(ARDUINO)
+  #include <condition_variable>
+  #include <mutex>
+  #include <thread>
+#endif
+
+#define PCA9622_FRAMEBUFFER_MAX_BUSES 8 // Buses committed in parallel on a host, further buses one after the other
+
+/**
+ * Logical RGB pixel of a PCA9622FrameBuffer
+ */
+struct PCA9622Pixel {
+    uint8_t device;      // Index of the device in the frame buffer
+    uint8_t regRedPwm;   // Register address for red color channel
+    uint8_t regGreenPwm; // Register address for green color channel
+    uint8_t regBluePwm;  // Register address for blue color channel
+};
+
+/**
+ * One frame buffer for many PCA9622 on one or more buses. The buffer holds
+ * 16 PWM values per device, device after device. commit() sends only the
+ * channels changed since the last commit as Auto-Increment bursts (see
+ * PCA9622::flush()). On a host, each bus is committed by its own worker
+ * thread, started at the first commit() and kept until the frame buffer is
+ * destroyed, up to PCA9622_FRAMEBUFFER_MAX_BUSES buses, and the devices of
+ * further buses one by one. On a microcontroller, devices with an asynchronous
+ * queue (see PCA9622::beginQueue()) are drained round-robin, one transfer
+ * per bus at a time
+ */
+class PCA9622FrameBuffer {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Constructor for PCA9622FrameBuffer
+     *
+     * @param devices    Array of initialized devices. Must stay valid for the
+     *                   lifetime of the frame buffer
+     * @param numDevices Number of devices
+     * @param buffer     Frame buffer of 16 * numDevices bytes
+     */
+    PCA9622FrameBuffer(PCA9622 **devices, uint8_t numDevices, uint8_t *buffer);
+
+#if !defined(ARDUINO)
+    /**
+     * Destructor for PCA9622FrameBuffer. Stops the bus workers
+     */
+    ~PCA9622FrameBuffer();
+#endif
+
+    /**
+     * Set the mapping of logical pixels to devices and registers
+     *
+     * @param pixels    Array of pixels. Must stay valid for the lifetime of
+     *                  the frame buffer
+     * @param numPixels Number of pixels
+     */
+    void setPixelMap(const PCA9622Pixel *pixels, uint16_t numPixels);
+
+    /**
+     * Set a logical RGB pixel
+     *
+     * @param pixel Index of the pixel in the pixel map
+     * @param r     Value for red color channel
+     * @param g     Value for green color channel
+     * @param b     Value for blue color channel
+     */
+    void setPixel(uint16_t pixel, uint8_t r, uint8_t g, uint8_t b);
+
+    /**
+     * Set a single channel
+     *
+     * @param device Index of the device
+     * @param regPwm Register address for PWM channel
+     * @param pwm    PWM value
+     */
+    void setChannel(uint8_t device, uint8_t regPwm, uint8_t pwm);
+
+    /**
+     * Direct access to the frame buffer, 16 PWM values per device
+     *
+     * @return frame buffer
+     */
+    uint8_t *getBuffer();
+
+    /**
+     * Set all channels to 0
+     */
+    void clear();
+
+    /**
+     * Send the frame to all devices. On a device in deferred mode, the frame
+     * is only staged until its next flush()
+     */
+    void commit();
+
+    /**
+     * @return duration of the last commit() in microseconds. On a host, the
+     *         bus time of the slowest bus thread
+     */
+    uint32_t lastCommitMicros();
+
+    /**
+     * @return longest duration of commit() in microseconds since construction
+     */
+    uint32_t maxCommitMicros();
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+    /**
+     * Stage the buffer of a device and flush it to the device or its queue.
+     * A device in deferred mode is not flushed
+     *
+     * @param device Index of the device
+     */
+    void stageDevice(uint8_t device);
+
+#if !defined(ARDUINO)
+    /**
+     * Find a bus in a list of buses
+     *
+     * @param buses    List of buses
+     * @param numBuses Number of buses in the list
+     * @param wire     Bus to find
+     *
+     * @return index of wire in buses, numBuses if not found
+     */
+    uint8_t findBus(TwoWire *const *buses, uint8_t numBuses, TwoWire *wire);
+
+    /**
+     * Commit all devices of one bus and wait until they are sent
+     *
+     * @param wire Bus to commit
+     *
+     * @return bus time of the commit in microseconds
+     */
+    uint32_t commitBus(TwoWire *wire);
+
+    /**
+     * Worker of one bus: commits the bus for every new frame until the frame
+     * buffer is destroyed
+     *
+     * @param bus   Index of the bus
+     * @param frame Last frame already committed when the worker starts
+     */
+    void runWorker(uint8_t bus, uint32_t frame);
+#endif
+
+    PCA9622 **_devices;
+    uint8_t _numDevices;
+    uint8_t *_buffer;
+
+    const PCA9622Pixel *_pixels;
+    uint16_t _numPixels;
+
+    uint32_t _lastCommitMicros;
+    uint32_t _maxCommitMicros;
+
+#if !defined(ARDUINO)
+    /**
+     * Buses of the current frame and their workers. Bus 0 is committed by
+     * the thread calling commit(), so _workers[0] is unused
+     */
+    TwoWire *_buses[PCA9622_FRAMEBUFFER_MAX_BUSES];
+    uint8_t _numBuses;
+    std::thread _workers[PCA9622_FRAMEBUFFER_MAX_BUSES];
+    uint8_t _numWorkers;
+
+    /**
+     * Frame handshake with the workers, guarded by _mutex
+     */
+    std::mutex _mutex;
+    std::condition_variable _frameStart;
+    std::condition_variable _frameDone;
+    uint32_t _frame;
+    uint8_t _busy;
+    uint32_t _busMicros[PCA9622_FRAMEBUFFER_MAX_BUSES];
+    bool _stop;
+#endif
+};
+#endif //PCA9622_FRAMEBUFFER_H
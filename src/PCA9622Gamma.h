@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef PCA9622_GAMMA_H
+#define PCA9622_GAMMA_H
+
+#include <Arduino.h>
+
+// Brightness correction tables, generated at compile time and stored in
+// flash. Select one with PCA9622::setGammaTable(), e.g.
+//
+//   pca9622.setGammaTable(PCA9622GammaTable<PCA9622GammaCie1931>::table);
+//   pca9622.setGammaTable(PCA9622GammaTable<PCA9622GammaPow<25, 10> >::table);
+
+#if defined(__AVR__)
+  #include <avr/pgmspace.h>
+  #define PCA9622_GAMMA_READ(table, index) pgm_read_byte(&(table)[index])
+#else
+  #ifndef PROGMEM
+    #define PROGMEM
+  #endif
+  #define PCA9622_GAMMA_READ(table, index) ((table)[index])
+#endif
+
+/**
+ * Compile-time math for the table generators. Only evaluated by the
+ * compiler, no floating point code ends up in the firmware
+ */
+struct PCA9622GammaMath {
+
+    static constexpr double square(double v) {
+      return v * v;
+    }
+
+    // ln(x) = 2 * (y + y^3/3 + y^5/5 + ...), y = (x - 1) / (x + 1)
+    static constexpr double lnSeries(double y2, double term, int k) {
+      return (k > 41) ? 0.0 : term / k + lnSeries(y2, term * y2, k + 2);
+    }
+
+    // Argument reduced to [0.5, 1] first, where the series converges fast
+    static constexpr double ln(double x) {
+      return (x < 0.5) ? ln(x * 2) - 0.69314718055994530942
+                       : 2 * lnSeries(square((x - 1) / (x + 1)), (x - 1) / (x + 1), 1);
+    }
+
+    static constexpr double expSeries(double z, double term, int k) {
+      return (k > 20) ? term : term + expSeries(z, term * z / k, k + 1);
+    }
+
+    // exp(z) = exp(z / 2)^2 until the Taylor series converges fast
+    static constexpr double exp(double z) {
+      return (z < -1.0) ? square(exp(z / 2)) : expSeries(z, 1.0, 1);
+    }
+
+    static constexpr double pow(double x, double exponent) {
+      return (x <= 0.0) ? 0.0 : exp(exponent * ln(x));
+    }
+
+    static constexpr uint8_t toPwm(double brightness) {
+      return (brightness >= 1.0) ? 255 : (uint8_t) (brightness * 255 + 0.5);
+    }
+};
+
+/**
+ * Power law correction, out = in^(Num/Den)
+ */
+template <uint16_t Num, uint16_t Den>
+struct PCA9622GammaPow {
+    static constexpr uint8_t value(uint16_t i) {
+      return PCA9622GammaMath::toPwm(PCA9622GammaMath::pow(i / 255.0, (double) Num / Den));
+    }
+};
+
+typedef PCA9622GammaPow<22, 10> PCA9622Gamma22;
+
+/**
+ * CIE 1931 lightness, the input is perceived lightness L* from 0 to 100%
+ */
+struct PCA9622GammaCie1931 {
+    static constexpr double luminance(double lightness) {
+      return (lightness <= 8.0) ? lightness / 903.3
+                                : PCA9622GammaMath::square((lightness + 16) / 116) * ((lightness + 16) / 116);
+    }
+
+    static constexpr uint8_t value(uint16_t i) {
+      return PCA9622GammaMath::toPwm(luminance(i * 100.0 / 255));
+    }
+};
+
+template <uint16_t... I>
+struct PCA9622GammaIndices {
+};
+
+template <uint16_t N, uint16_t... I>
+struct PCA9622GammaMakeIndices : PCA9622GammaMakeIndices<N - 1, N - 1, I...> {
+};
+
+template <uint16_t... I>
+struct PCA9622GammaMakeIndices<0, I...> {
+    typedef PCA9622GammaIndices<I...> type;
+};
+
+template <class Curve, class Indices>
+struct PCA9622GammaTableImpl;
+
+template <class Curve, uint16_t... I>
+struct PCA9622GammaTableImpl<Curve, PCA9622GammaIndices<I...> > {
+    static const uint8_t table[256];
+};
+
+template <class Curve, uint16_t... I>
+const uint8_t PCA9622GammaTableImpl<Curve, PCA9622GammaIndices<I...> >::table[256] PROGMEM = { Curve::value(I)... };
+
+/**
+ * 256 entry lookup table in flash for a correction curve, e.g.
+ * PCA9622GammaTable<PCA9622Gamma22>::table
+ */
+template <class Curve>
+struct PCA9622GammaTable : PCA9622GammaTableImpl<Curve, typename PCA9622GammaMakeIndices<256>::type> {
+};
+#endif //PCA9622_GAMMA_H
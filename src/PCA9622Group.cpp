@@ -0,0 +1,329 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#include "PCA9622Group.h"
+#include "PCA9622Trace.h"
+
+// MODE1 enable bit and address register per group address type
+static const uint8_t groupModeBit[] = { BIT_ALLCALL, BIT_SUB1, BIT_SUB2, BIT_SUB3 };
+static const uint8_t groupAddressReg[] = { REG_ALLCALLADR, REG_SUBADR1, REG_SUBADR2, REG_SUBADR3 };
+
+/******************************* PUBLIC METHODS *******************************/
+
+
+    /**
+     * Constructor for PCA9622Group
+     *
+     * @param devices    Array of initialized members, all on the same bus.
+     *                   Must stay valid for the lifetime of the group
+     * @param numDevices Number of members
+     */
+PCA9622Group::PCA9622Group(PCA9622 **devices, uint8_t numDevices) {
+
+  _devices = devices;
+  _numDevices = numDevices;
+
+  _groupAddress = 0;
+  _addressType = GROUP_ADDRESS_ALLCALL;
+}
+
+    /**
+     * Program the group address into all members and enable it in MODE1
+     *
+     * @param groupAddress 7-bit I2C address of the group
+     * @param addressType  One of GROUP_ADDRESS_ALLCALL, GROUP_ADDRESS_SUB1,
+     *                     GROUP_ADDRESS_SUB2 or GROUP_ADDRESS_SUB3
+     */
+void PCA9622Group::begin(uint8_t groupAddress, uint8_t addressType) {
+
+  if (addressType > GROUP_ADDRESS_SUB3) {
+    addressType = GROUP_ADDRESS_ALLCALL;
+  }
+
+  _groupAddress = groupAddress;
+  _addressType = addressType;
+
+  // The address registers hold the address in bits 7:1
+  for (uint8_t i = 0; i < _numDevices; i++) {
+    PCA9622 *device = _devices[i];
+
+    device->writeReg(groupAddressReg[addressType], groupAddress << 1);
+    device->writeReg(REG_MODE1, device->_reg[REG_MODE1] | (1 << groupModeBit[addressType]));
+  }
+}
+
+    /**
+     * Disable the group address in MODE1 of all members
+     */
+void PCA9622Group::end() {
+
+  for (uint8_t i = 0; i < _numDevices; i++) {
+    PCA9622 *device = _devices[i];
+
+    device->writeReg(REG_MODE1, device->_reg[REG_MODE1] & ~(1 << groupModeBit[_addressType]));
+  }
+}
+
+    /**
+     * Switch all members to low-power mode. Oscillator off
+     */
+void PCA9622Group::sleep() {
+
+  for (uint8_t i = 0; i < _numDevices; i++) {
+    _devices[i]->countSleep(true);
+  }
+
+  writeRegBits(REG_MODE1, 1 << BIT_SLEEP, 1 << BIT_SLEEP);
+}
+
+    /**
+     * Switch all members to normal mode
+     */
+void PCA9622Group::wakeUp() {
+
+  for (uint8_t i = 0; i < _numDevices; i++) {
+    _devices[i]->countSleep(false);
+  }
+
+  writeRegBits(REG_MODE1, 1 << BIT_SLEEP, 0);
+}
+
+    /**
+     * Turn on all LEDs of all members. Restores settings saved at turnOff()
+     */
+void PCA9622Group::turnOn() {
+
+  bool same = true;
+
+  for (uint8_t i = 0; i < _numDevices && same; i++) {
+    same = _devices[i]->_turnedOff
+        && memcmp(_devices[i]->_storedRegLedout, _devices[0]->_storedRegLedout, 4) == 0;
+  }
+
+  if (!same) {
+    for (uint8_t i = 0; i < _numDevices; i++) {
+      _devices[i]->turnOn();
+    }
+    return;
+  }
+
+  if (_numDevices > 0) {
+    uint8_t ledout[4];
+
+    memcpy(ledout, _devices[0]->_storedRegLedout, 4);
+    writeRegs(AI_ALL, REG_LEDOUT0, ledout, 4);
+
+    for (uint8_t i = 0; i < _numDevices; i++) {
+      _devices[i]->_turnedOff = false;
+    }
+  }
+}
+
+    /**
+     * Turn off all LEDs of all members. Saves current settings for turnOn()
+     */
+void PCA9622Group::turnOff() {
+
+  for (uint8_t i = 0; i < _numDevices; i++) {
+    _devices[i]->saveLedout();
+  }
+
+  const uint8_t ledout[4] = { LDR_STATE_OFF, LDR_STATE_OFF, LDR_STATE_OFF, LDR_STATE_OFF };
+
+  writeRegs(AI_ALL, REG_LEDOUT0, ledout, 4);
+}
+
+    /**
+     * Set individual PWM value for a given channel on all members. The value
+     * is sent as is, without the brightness correction of the members (see
+     * PCA9622::setGammaTable())
+     *
+     * @param regPwm Register address for PWM channel
+     * @param pwm    PWM value
+     */
+void PCA9622Group::setPwm(uint8_t regPwm, uint8_t pwm) {
+
+  writeRegs(AI_DISABLED, regPwm, &pwm, 1);
+}
+
+    /**
+     * Set individual PWM values for all 16 channels on all members. The
+     * values are sent as is, without the brightness correction of the members
+     * (see PCA9622::setGammaTable())
+     *
+     * @param pwm Array of 16 PWM values, starting with channel 0
+     */
+void PCA9622Group::setAllPwm(const uint8_t pwm[16]) {
+
+  writeRegs(AI_IND, REG_PWM0, pwm, 16);
+}
+
+    /**
+     * Set global PWM value on all members
+     *
+     * @param pwm PWM value
+     */
+void PCA9622Group::setGrpPwm(uint8_t pwm) {
+
+  writeRegs(AI_DISABLED, REG_GRPPWM, &pwm, 1);
+}
+
+    /**
+     * Set up values for blinking mode on all members, see
+     * PCA9622::setBlinking()
+     *
+     * @param blinkPeriod Period for one blink (turning off and on)
+     * @param onOffRatio  Value between 0.0 and 1.0
+     */
+void PCA9622Group::setBlinking(uint8_t blinkPeriod, float onOffRatio) {
+
+  setBlinkingPermille(blinkPeriod, PCA9622::permille(onOffRatio));
+}
+
+    /**
+     * Set up values for blinking mode on all members with integer math, see
+     * PCA9622::setBlinkingPermille()
+     *
+     * @param blinkPeriod   Period for one blink (turning off and on)
+     * @param onOffPermille Time the LEDs are on in 1/1000 of the period,
+     *                      0 to 1000
+     */
+void PCA9622Group::setBlinkingPermille(uint8_t blinkPeriod, uint16_t onOffPermille) {
+
+  const uint8_t data[2] = { PCA9622::blinkRatio(onOffPermille), blinkPeriod };
+
+  writeRegs(AI_GBL, REG_GRPPWM, data, 2);
+}
+
+    /**
+     * Set the LED driver output state for all channels on all members
+     *
+     * @param state One of the four possible states (see LDR_STATE_*)
+     */
+void PCA9622Group::setLdrStateAll(uint8_t state) {
+
+  uint8_t newReg = ( state << BIT_LDR3
+                   | state << BIT_LDR2
+                   | state << BIT_LDR1
+                   | state << BIT_LDR0);
+
+  const uint8_t ledout[4] = { newReg, newReg, newReg, newReg };
+
+  writeRegs(AI_ALL, REG_LEDOUT0, ledout, 4);
+}
+
+    /**
+     * Set the group control mode on all members
+     *
+     * @param mode GROUP_CONTROL_MODE_BLINKING or GROUP_CONTROL_MODE_DIMMING
+     */
+void PCA9622Group::setGroupControlMode(uint8_t mode) {
+
+  uint8_t bits = (mode == GROUP_CONTROL_MODE_BLINKING) ? (1 << BIT_DMBLNK) : 0;
+
+  writeRegBits(REG_MODE2, 1 << BIT_DMBLNK, bits);
+}
+
+/****************************** PRIVATE METHODS *******************************/
+
+
+    /**
+     * Change bits of a register on all members. Broadcast if all members
+     * end up with the same content, otherwise written per member
+     *
+     * @param registerAddress Register address
+     * @param mask            Bits to change
+     * @param bits            New value of the bits to change
+     */
+void PCA9622Group::writeRegBits(uint8_t registerAddress, uint8_t mask, uint8_t bits) {
+
+  if (_numDevices == 0) {
+    return;
+  }
+
+  uint8_t newReg = (_devices[0]->_reg[registerAddress] & ~mask) | bits;
+  bool same = true;
+
+  for (uint8_t i = 1; i < _numDevices && same; i++) {
+    same = ((_devices[i]->_reg[registerAddress] & ~mask) | bits) == newReg;
+  }
+
+  if (same) {
+    writeRegs(AI_DISABLED, registerAddress, &newReg, 1);
+    return;
+  }
+
+  for (uint8_t i = 0; i < _numDevices; i++) {
+    PCA9622 *device = _devices[i];
+
+    device->writeReg(registerAddress, (device->_reg[registerAddress] & ~mask) | bits);
+  }
+}
+
+    /**
+     * Write data to consecutive registers of all members in one transfer to
+     * the group address and update the register cache of all members. Members
+     * that were automatically put to sleep wake up once the data was sent
+     *
+     * The result counts in the bus statistics and last error of every member.
+     * On failure the caches keep their old content and the members are marked
+     * for recovery, see checkHealth().
+     *
+     * @param option          Auto-Increment option for this transfer (see AI_*)
+     * @param registerAddress First register address to write to
+     * @param data            Data to write
+     * @param count           Number of bytes to write
+     */
+void PCA9622Group::writeRegs(uint8_t option, uint8_t registerAddress, const uint8_t *data, uint8_t count) {
+
+  if (_numDevices == 0) {
+    return;
+  }
+
+  TwoWire *wire = _devices[0]->_wire;
+
+  uint8_t control = (option << BIT_CTRL_AI) | (registerAddress & MASK_CTRL_REG);
+
+  // Keep the order with writes still queued on the members, and give members
+  // that just woke up their oscillator start-up time
+  for (uint8_t i = 0; i < _numDevices; i++) {
+    _devices[i]->wait(_devices[i]->lastToken());
+    _devices[i]->oscillatorGuard(control, count);
+  }
+
+  uint32_t start = micros();
+
+  wire->beginTransmission(_groupAddress);
+  wire->write(control);
+  wire->write(data, count);
+  uint8_t status = wire->endTransmission();
+  uint32_t elapsed = micros() - start;
+
+  PCA9622_TRACE_TRANSFER(start, _groupAddress, control, count > 0 ? data[0] : 0, count, status);
+
+  // Every member accounts for the broadcast, but only caches it if it was acknowledged
+  for (uint8_t i = 0; i < _numDevices; i++) {
+    PCA9622 *device = _devices[i];
+
+    device->recordTransfer(status, count + 2, elapsed);
+    device->_lastError = status;
+
+    if (status == PCA9622_OK) {
+      device->cacheRegs(option, registerAddress, data, count);
+
+      if (registerAddress == REG_MODE1 && count > 0) {
+        device->trackMode1(data[0]);
+      }
+      device->autoWake();
+    }
+    else {
+      device->_stats.errors++;
+      device->_transferFailed = true;
+    }
+  }
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef PCA9622_GROUP_H
+#define PCA9622_GROUP_H
+
+#include "PCA9622.h"
+
+// Group address types, see PCA9622Group::begin()
+#define GROUP_ADDRESS_ALLCALL 0 // LED All Call I2C-bus address, ALLCALLADR
+#define GROUP_ADDRESS_SUB1    1 // I2C-bus subaddress 1, SUBADR1
+#define GROUP_ADDRESS_SUB2    2 // I2C-bus subaddress 2, SUBADR2
+#define GROUP_ADDRESS_SUB3    3 // I2C-bus subaddress 3, SUBADR3
+
+/**
+ * Several PCA9622 on the same bus sharing an All Call or subaddress. Writes
+ * through the group are sent once to the group address and update the
+ * register cache of every member. Where members would end up with different
+ * register contents (e.g. turnOn() with different saved states), the group
+ * falls back to writing each member individually. PWM values are written as
+ * given, the brightness correction of the members does not apply
+ */
+class PCA9622Group {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Constructor for PCA9622Group
+     *
+     * @param devices    Array of initialized members, all on the same bus.
+     *                   Must stay valid for the lifetime of the group
+     * @param numDevices Number of members
+     */
+    PCA9622Group(PCA9622 **devices, uint8_t numDevices);
+
+    /**
+     * Program the group address into all members and enable it in MODE1
+     *
+     * @param groupAddress 7-bit I2C address of the group
+     * @param addressType  One of GROUP_ADDRESS_ALLCALL, GROUP_ADDRESS_SUB1,
+     *                     GROUP_ADDRESS_SUB2 or GROUP_ADDRESS_SUB3
+     */
+    void begin(uint8_t groupAddress, uint8_t addressType);
+
+    /**
+     * Disable the group address in MODE1 of all members
+     */
+    void end();
+
+    /**
+     * Switch all members to low-power mode. Oscillator off
+     */
+    void sleep();
+
+    /**
+     * Switch all members to normal mode
+     */
+    void wakeUp();
+
+    /**
+     * Turn on all LEDs of all members. Restores settings saved at turnOff()
+     */
+    void turnOn();
+
+    /**
+     * Turn off all LEDs of all members. Saves current settings for turnOn()
+     */
+    void turnOff();
+
+    /**
+     * Set individual PWM value for a given channel on all members. The value
+     * is sent as is, without the brightness correction of the members (see
+     * PCA9622::setGammaTable())
+     *
+     * @param regPwm Register address for PWM channel
+     * @param pwm    PWM value
+     */
+    void setPwm(uint8_t regPwm, uint8_t pwm);
+
+    /**
+     * Set individual PWM values for all 16 channels on all members. The
+     * values are sent as is, without the brightness correction of the members
+     * (see PCA9622::setGammaTable())
+     *
+     * @param pwm Array of 16 PWM values, starting with channel 0
+     */
+    void setAllPwm(const uint8_t pwm[16]);
+
+    /**
+     * Set global PWM value on all members
+     *
+     * @param pwm PWM value
+     */
+    void setGrpPwm(uint8_t pwm);
+
+    /**
+     * Set up values for blinking mode on all members, see
+     * PCA9622::setBlinking()
+     *
+     * @param blinkPeriod Period for one blink (turning off and on)
+     * @param onOffRatio  Value between 0.0 and 1.0
+     */
+    void setBlinking(uint8_t blinkPeriod, float onOffRatio);
+
+    /**
+     * Set up values for blinking mode on all members with integer math, see
+     * PCA9622::setBlinkingPermille()
+     *
+     * @param blinkPeriod   Period for one blink (turning off and on)
+     * @param onOffPermille Time the LEDs are on in 1/1000 of the period,
+     *                      0 to 1000
+     */
+    void setBlinkingPermille(uint8_t blinkPeriod, uint16_t onOffPermille);
+
+    /**
+     * Set the LED driver output state for all channels on all members
+     *
+     * @param state One of the four possible states (see LDR_STATE_*)
+     */
+    void setLdrStateAll(uint8_t state);
+
+    /**
+     * Set the group control mode on all members
+     *
+     * @param mode GROUP_CONTROL_MODE_BLINKING or GROUP_CONTROL_MODE_DIMMING
+     */
+    void setGroupControlMode(uint8_t mode);
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+    /**
+     * Change bits of a register on all members. Broadcast if all members
+     * end up with the same content, otherwise written per member
+     *
+     * @param registerAddress Register address
+     * @param mask            Bits to change
+     * @param bits            New value of the bits to change
+     */
+    void writeRegBits(uint8_t registerAddress, uint8_t mask, uint8_t bits);
+
+    /**
+     * Write data to consecutive registers of all members in one transfer to
+     * the group address and update the register cache of all members. Members
+     * that were automatically put to sleep wake up once the data was sent
+     *
+     * The result counts in the bus statistics and last error of every member.
+     * On failure the caches keep their old content and the members are marked
+     * for recovery, see checkHealth().
+     *
+     * @param option          Auto-Increment option for this transfer (see AI_*)
+     * @param registerAddress First register address to write to
+     * @param data            Data to write
+     * @param count           Number of bytes to write
+     */
+    void writeRegs(uint8_t option, uint8_t registerAddress, const uint8_t *data, uint8_t count);
+
+    /**
+     * Members of the group
+     */
+    PCA9622 **_devices;
+    uint8_t _numDevices;
+
+    /**
+     * 7-bit I2C address and type of the group address
+     */
+    uint8_t _groupAddress;
+    uint8_t _addressType;
+};
+#endif //PCA9622_GROUP_H
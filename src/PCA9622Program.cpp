@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#include "PCA9622Program.h"
+
+#if defined(__AVR__)
+  #include <avr/pgmspace.h>
+  #define PROGRAM_READ(program, index, inFlash) ((inFlash) ? pgm_read_byte(&(program)[index]) : (program)[index])
+#else
+  #define PROGRAM_READ(program, index, inFlash) ((program)[index])
+#endif
+
+#if !defined(ARDUINO)
+  // No interrupts on a host
+  #define noInterrupts()
+  #define interrupts()
+#endif
+
+/******************************* PUBLIC METHODS *******************************/
+
+
+    /**
+     * Start recording. Subsequent calls to device are recorded until end()
+     *
+     * @param device Device to record. Its register cache is the start state
+     *               of the program
+     */
+void PCA9622Recorder::begin(PCA9622 *device) {
+
+  _device = device;
+
+  memcpy(_savedReg, device->_reg, PCA9622_NUM_REGS);
+  _savedDirtyRegs = device->_dirtyRegs;
+  _savedDeferred = device->_deferred;
+
+  _device->_dirtyRegs = 0;
+  _device->_deferred = true;
+}
+
+    /**
+     * Stop recording and write the program
+     *
+     * @param program Buffer for the program, PCA9622_PROGRAM_MAX_SIZE bytes
+     *                fit every program
+     * @param size    Size of program
+     *
+     * @return length of the program in bytes, 0 if it does not fit
+     */
+uint8_t PCA9622Recorder::end(uint8_t *program, uint8_t size) {
+
+  uint32_t changed = 0;
+
+  for (uint8_t reg = 0; reg < PCA9622_NUM_REGS; reg++) {
+    if (_device->_reg[reg] != _savedReg[reg]) {
+      changed |= (1UL << reg);
+    }
+  }
+
+  // Same ranges as PCA9622::flush(). Bridged registers keep their start value
+  uint8_t length = 0;
+  uint8_t first = REG_MODE1;
+
+  while (changed != 0) {
+    while (!(changed & (1UL << first))) {
+      first++;
+    }
+
+    uint8_t last = first;
+
+    for (uint8_t reg = first + 1; reg < PCA9622_NUM_REGS && reg - last <= PCA9622_FLUSH_MAX_GAP + 1; reg++) {
+      if (changed & (1UL << reg)) {
+        last = reg;
+      }
+    }
+
+    changed &= ~(((1UL << (last + 1)) - 1) & ~((1UL << first) - 1));
+
+    uint8_t count = last - first + 1;
+
+    // Leave room for the end
+    if (length + 2 + count >= size) {
+      length = size;
+      break;
+    }
+
+    program[length++] = count;
+    program[length++] = first;
+    memcpy(&program[length], &_device->_reg[first], count);
+    length += count;
+
+    first = last + 1;
+  }
+
+  memcpy(_device->_reg, _savedReg, PCA9622_NUM_REGS);
+  _device->_dirtyRegs = _savedDirtyRegs;
+  _device->_deferred = _savedDeferred;
+
+  if (length >= size) {
+    return 0;
+  }
+
+  program[length++] = PROGRAM_END;
+
+  return length;
+}
+
+    /**
+     * Constructor for PCA9622ProgramPlayer
+     *
+     * @param device Device to play programs on. Must stay valid for the
+     *               lifetime of the player
+     */
+PCA9622ProgramPlayer::PCA9622ProgramPlayer(PCA9622 *device) {
+
+  _device = device;
+  _pending = NULL;
+  _pendingInFlash = false;
+}
+
+    /**
+     * Play a program and take its registers over into the register cache.
+     * In deferred mode the registers are staged
+     *
+     * @param program Program written by PCA9622Recorder::end()
+     * @param inFlash true if program is in flash memory (PROGMEM)
+     *
+     * @return PCA9622_OK, PCA9622_ERR_TOO_LONG for an invalid program, or
+     *         the status of the last transfer
+     */
+uint8_t PCA9622ProgramPlayer::play(const uint8_t *program, bool inFlash) {
+
+  uint8_t data[PCA9622_NUM_REGS];
+  uint16_t i = 0;
+
+  _device->_lastError = PCA9622_OK;
+
+  for (;;) {
+    uint8_t count = PROGRAM_READ(program, i, inFlash);
+
+    if (count == PROGRAM_END) {
+      break;
+    }
+
+    if (count > PCA9622_NUM_REGS) {
+      return PCA9622_ERR_TOO_LONG;
+    }
+
+    uint8_t reg = PROGRAM_READ(program, i + 1, inFlash) & MASK_CTRL_REG;
+    const uint8_t *values = &program[i + 2];
+
+    if (inFlash) {
+      for (uint8_t j = 0; j < count; j++) {
+        data[j] = PROGRAM_READ(program, i + 2 + j, inFlash);
+      }
+      values = data;
+    }
+
+    _device->writeRegs(AI_ALL, reg, values, count);
+
+    i += 2 + count;
+  }
+
+  return _device->_lastError;
+}
+
+    /**
+     * Request to play a program at the next update(). Safe to call from an
+     * interrupt handler: it only stores the program pointer. A request
+     * replaces a previous one that was not played yet
+     *
+     * @param program Program written by PCA9622Recorder::end()
+     * @param inFlash true if program is in flash memory (PROGMEM)
+     */
+void PCA9622ProgramPlayer::trigger(const uint8_t *program, bool inFlash) {
+
+  _pendingInFlash = inFlash;
+  _pending = program;
+}
+
+    /**
+     * Play the program requested with trigger(), if any. Call this
+     * regularly from the main loop
+     *
+     * @return true if a program was played
+     */
+bool PCA9622ProgramPlayer::update() {
+
+  // The pointer takes more than one load on 8-bit cores
+  noInterrupts();
+  const uint8_t *program = _pending;
+  bool inFlash = _pendingInFlash;
+  _pending = NULL;
+  interrupts();
+
+  if (program == NULL) {
+    return false;
+  }
+
+  play(program, inFlash);
+
+  return true;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef PCA9622_PROGRAM_H
+#define PCA9622_PROGRAM_H
+
+#include "PCA9622.h"
+
+/*
+ * Register program. A sequence of transfers, each with Auto-Increment for
+ * all registers (AI_ALL):
+ *
+ *   Transfer number of registers (1 to PCA9622_NUM_REGS),
+ *            first register, register values
+ *   End      0
+ *
+ * A program brings a chip from the register state at recording start to
+ * the state at recording end. Registers that end up unchanged are left
+ * out, changed registers close to each other share one transfer
+ */
+#define PCA9622_PROGRAM_MAX_SIZE (PCA9622_NUM_REGS + 3) // All registers in one transfer, and the end
+#define PROGRAM_END              0                       // Number of registers that ends a program
+
+/**
+ * Records calls to a PCA9622 into a register program. While recording,
+ * nothing is sent on the bus: the calls only work on the register cache,
+ * as in deferred mode. At the end the program is computed from the
+ * registers that changed, and the device gets back its register cache
+ * from before the recording. Other state, e.g. the bus statistics, is not
+ * rolled back
+ */
+class PCA9622Recorder {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Start recording. Subsequent calls to device are recorded until end()
+     *
+     * @param device Device to record. Its register cache is the start state
+     *               of the program
+     */
+    void begin(PCA9622 *device);
+
+    /**
+     * Stop recording and write the program
+     *
+     * @param program Buffer for the program, PCA9622_PROGRAM_MAX_SIZE bytes
+     *                fit every program
+     * @param size    Size of program
+     *
+     * @return length of the program in bytes, 0 if it does not fit
+     */
+    uint8_t end(uint8_t *program, uint8_t size);
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+    PCA9622 *_device;
+
+    /**
+     * Register cache, dirty registers and deferred mode of the device from
+     * before the recording
+     */
+    uint8_t _savedReg[PCA9622_NUM_REGS];
+    uint32_t _savedDirtyRegs;
+    bool _savedDeferred;
+};
+
+/**
+ * Plays register programs on a device. A program takes one transfer per
+ * range of registers, the values are sent as they are
+ */
+class PCA9622ProgramPlayer {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Constructor for PCA9622ProgramPlayer
+     *
+     * @param device Device to play programs on. Must stay valid for the
+     *               lifetime of the player
+     */
+    PCA9622ProgramPlayer(PCA9622 *device);
+
+    /**
+     * Play a program and take its registers over into the register cache.
+     * In deferred mode the registers are staged
+     *
+     * @param program Program written by PCA9622Recorder::end()
+     * @param inFlash true if program is in flash memory (PROGMEM)
+     *
+     * @return PCA9622_OK, PCA9622_ERR_TOO_LONG for an invalid program, or
+     *         the status of the last transfer
+     */
+    uint8_t play(const uint8_t *program, bool inFlash = false);
+
+    /**
+     * Request to play a program at the next update(). Safe to call from an
+     * interrupt handler: it only stores the program pointer. A request
+     * replaces a previous one that was not played yet
+     *
+     * @param program Program written by PCA9622Recorder::end()
+     * @param inFlash true if program is in flash memory (PROGMEM)
+     */
+    void trigger(const uint8_t *program, bool inFlash = false);
+
+    /**
+     * Play the program requested with trigger(), if any. Call this
+     * regularly from the main loop
+     *
+     * @return true if a program was played
+     */
+    bool update();
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+    PCA9622 *_device;
+
+    const uint8_t * volatile _pending;
+    volatile bool _pendingInFlash;
+};
+#endif //PCA9622_PROGRAM_H
@@ -0,0 +1,363 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#include "PCA9622Stream.h"
+
+#define VARINT_MAX_BYTES 5 // 32-bit values
+
+/******************************* PUBLIC METHODS *******************************/
+
+
+    /**
+     * Constructor for PCA9622MemorySource
+     *
+     * @param data Stream bytes. Must stay valid while they are read
+     * @param size Number of bytes
+     */
+PCA9622MemorySource::PCA9622MemorySource(const uint8_t *data, uint32_t size) {
+
+  _data = data;
+  _size = size;
+  _position = 0;
+}
+
+uint16_t PCA9622MemorySource::read(uint8_t *buffer, uint16_t size) {
+
+  uint32_t left = _size - _position;
+  uint16_t count = (left < size) ? left : size;
+
+  memcpy(buffer, &_data[_position], count);
+  _position += count;
+
+  return count;
+}
+
+bool PCA9622MemorySource::atEnd() {
+
+  return _position >= _size;
+}
+
+#if defined(ARDUINO)
+    /**
+     * Constructor for PCA9622StreamSource
+     *
+     * @param stream     Stream to read from
+     * @param endAtEmpty true if the stream ended once nothing is available
+     *                   (files), false to wait for more data (serial ports)
+     */
+PCA9622StreamSource::PCA9622StreamSource(Stream &stream, bool endAtEmpty)
+       : _stream(stream) {
+
+  _endAtEmpty = endAtEmpty;
+}
+
+uint16_t PCA9622StreamSource::read(uint8_t *buffer, uint16_t size) {
+
+  int available = _stream.available();
+  uint16_t count = (available < size) ? available : size;
+
+  return (count > 0) ? _stream.readBytes(buffer, count) : 0;
+}
+
+bool PCA9622StreamSource::atEnd() {
+
+  return _endAtEmpty && _stream.available() <= 0;
+}
+#endif
+
+    /**
+     * Constructor for PCA9622StreamPlayer
+     *
+     * @param devices    Array of initialized devices, indexed by the device
+     *                   index of the records. Must stay valid for the
+     *                   lifetime of the player
+     * @param numDevices Number of devices
+     * @param window     Buffer for stream bytes, at least
+     *                   PCA9622_STREAM_MIN_WINDOW bytes
+     * @param windowSize Size of window
+     */
+PCA9622StreamPlayer::PCA9622StreamPlayer(PCA9622 **devices, uint8_t numDevices, uint8_t *window, uint16_t windowSize) {
+
+  _devices = devices;
+  _numDevices = numDevices;
+
+  _window = window;
+  _windowSize = windowSize;
+  _position = 0;
+  _length = 0;
+
+  _source = NULL;
+  _status = STREAM_END;
+  _frameLoaded = false;
+  _records = 0;
+  _start = 0;
+  _frameTime = 0;
+
+  _frames = 0;
+  _lastDrift = 0;
+  _maxDrift = 0;
+  _underruns = 0;
+}
+
+    /**
+     * Start playing a stream. The header must be available from the source
+     *
+     * @param source Source of the stream. Must stay valid while playing
+     * @param now    Current time in microseconds, e.g. micros(). Frame times
+     *               are relative to it
+     *
+     * @return STREAM_PLAYING or STREAM_ERR_*
+     */
+uint8_t PCA9622StreamPlayer::begin(PCA9622ByteSource *source, uint32_t now) {
+
+  _source = source;
+  _position = 0;
+  _length = 0;
+
+  _frameLoaded = false;
+  _records = 0;
+  _start = now;
+  _frameTime = 0;
+
+  _frames = 0;
+  _lastDrift = 0;
+  _maxDrift = 0;
+  _underruns = 0;
+
+  if (_windowSize < PCA9622_STREAM_MIN_WINDOW || fill(PCA9622_STREAM_HEADER_SIZE) < PCA9622_STREAM_HEADER_SIZE) {
+    _status = STREAM_ERR_HEADER;
+    return _status;
+  }
+
+  const uint8_t *header = &_window[_position];
+
+  if (header[0] != 'P' || header[1] != '9' || header[2] != 'S' || header[3] != PCA9622_STREAM_VERSION) {
+    _status = STREAM_ERR_HEADER;
+  }
+  else if (header[4] > _numDevices) {
+    _status = STREAM_ERR_DEVICES;
+  }
+  else {
+    _status = STREAM_PLAYING;
+  }
+
+  _position += PCA9622_STREAM_HEADER_SIZE;
+
+  return _status;
+}
+
+    /**
+     * Play all frames that are due. Call this regularly from the main loop
+     *
+     * @param now Current time in microseconds, e.g. micros()
+     *
+     * @return STREAM_PLAYING, STREAM_END or STREAM_ERR_*
+     */
+uint8_t PCA9622StreamPlayer::update(uint32_t now) {
+
+  while (_status == STREAM_PLAYING) {
+    if (!_frameLoaded) {
+      _status = loadFrame();
+
+      if (!_frameLoaded) {
+        break;
+      }
+    }
+
+    uint32_t due = _start + _frameTime;
+
+    if ((int32_t) (now - due) < 0) {
+      break;
+    }
+
+    while (_records > 0 && _status == STREAM_PLAYING) {
+      uint8_t records = _records;
+
+      _status = playRecord();
+
+      if (_records == records) {
+        break;
+      }
+    }
+
+    if (_records > 0) {
+      if (_status == STREAM_PLAYING) {
+        _underruns++;
+      }
+      break;
+    }
+
+    _frameLoaded = false;
+    _frames++;
+    _lastDrift = micros() - due;
+
+    if (_lastDrift > _maxDrift) {
+      _maxDrift = _lastDrift;
+    }
+  }
+
+  return _status;
+}
+
+    /**
+     * @return frames played since begin()
+     */
+uint32_t PCA9622StreamPlayer::frames() {
+
+  return _frames;
+}
+
+    /**
+     * @return time the last frame was completed after it was due, in
+     *         microseconds
+     */
+uint32_t PCA9622StreamPlayer::lastDriftMicros() {
+
+  return _lastDrift;
+}
+
+    /**
+     * @return largest drift since begin(), in microseconds
+     */
+uint32_t PCA9622StreamPlayer::maxDriftMicros() {
+
+  return _maxDrift;
+}
+
+    /**
+     * @return calls to update() that found a due frame incomplete because
+     *         the source had no data yet
+     */
+uint32_t PCA9622StreamPlayer::underruns() {
+
+  return _underruns;
+}
+
+/****************************** PRIVATE METHODS *******************************/
+
+
+    /**
+     * Make bytes available in the window, refilling it from the source
+     *
+     * @param count Number of bytes needed
+     *
+     * @return number of bytes available, less than count if the source has
+     *         no more data right now
+     */
+uint16_t PCA9622StreamPlayer::fill(uint16_t count) {
+
+  uint16_t available = _length - _position;
+
+  if (available >= count) {
+    return available;
+  }
+
+  // Keep unread bytes contiguous at the start of the window, so a record
+  // can always be passed to a transfer directly
+  memmove(_window, &_window[_position], available);
+  _position = 0;
+  _length = available;
+
+  while (_length < _windowSize) {
+    uint16_t read = _source->read(&_window[_length], _windowSize - _length);
+
+    if (read == 0) {
+      break;
+    }
+    _length += read;
+  }
+
+  return _length;
+}
+
+    /**
+     * Read the time and record count of the next frame into _frameTime and
+     * _records
+     *
+     * @return STREAM_PLAYING if the frame header was read or is still
+     *         incomplete, STREAM_END or STREAM_ERR_*
+     */
+uint8_t PCA9622StreamPlayer::loadFrame() {
+
+  uint16_t available = fill(VARINT_MAX_BYTES + 1);
+
+  if (available == 0) {
+    return _source->atEnd() ? STREAM_END : STREAM_PLAYING;
+  }
+
+  uint32_t delta = 0;
+  uint8_t length = 0;
+
+  do {
+    if (length == VARINT_MAX_BYTES) {
+      return STREAM_ERR_FORMAT;
+    }
+
+    if (length + 1 >= available) {
+      // Varint or record count incomplete
+      return _source->atEnd() ? STREAM_ERR_FORMAT : STREAM_PLAYING;
+    }
+
+    delta |= (uint32_t) (_window[_position + length] & 0x7F) << (7 * length);
+  } while (_window[_position + length++] & 0x80);
+
+  _records = _window[_position + length];
+  _position += length + 1;
+
+  _frameTime += delta * 1000;
+  _frameLoaded = true;
+
+  return STREAM_PLAYING;
+}
+
+    /**
+     * Write the next record of the current frame
+     *
+     * @return STREAM_PLAYING if written or still incomplete, or STREAM_ERR_*
+     */
+uint8_t PCA9622StreamPlayer::playRecord() {
+
+  uint16_t available = fill(3);
+
+  if (available < 3) {
+    return _source->atEnd() ? STREAM_ERR_FORMAT : STREAM_PLAYING;
+  }
+
+  const uint8_t *record = &_window[_position];
+  uint8_t device = record[0];
+  uint8_t registerAddress = record[1] & MASK_CTRL_REG;
+  bool isFill = record[1] & STREAM_RECORD_FILL;
+  uint8_t count = record[2];
+  uint8_t size = 3 + (isFill ? 1 : count);
+
+  if (device >= _numDevices || registerAddress >= PCA9622_NUM_REGS || count == 0 || count > PCA9622_NUM_REGS) {
+    return STREAM_ERR_FORMAT;
+  }
+
+  if (fill(size) < size) {
+    return _source->atEnd() ? STREAM_ERR_FORMAT : STREAM_PLAYING;
+  }
+
+  // The window may have moved
+  record = &_window[_position];
+
+  if (isFill) {
+    uint8_t values[PCA9622_NUM_REGS];
+
+    memset(values, record[3], count);
+    _devices[device]->writeRegs(AI_ALL, registerAddress, values, count);
+  }
+  else {
+    _devices[device]->writeRegs(AI_ALL, registerAddress, &record[3], count);
+  }
+
+  _position += size;
+  _records--;
+
+  return STREAM_PLAYING;
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef PCA9622_STREAM_H
+#define PCA9622_STREAM_H
+
+#include "PCA9622.h"
+
+/*
+ * Frame stream format, version 1. All values are unsigned.
+ *
+ *   Header   'P' '9' 'S', version (1 byte), number of devices (1 byte)
+ *   Frame    time since the previous frame in ms (varint: 7 bits per byte,
+ *            least significant first, bit 7 set if more bytes follow),
+ *            number of records (1 byte), records
+ *   Record   device index (1 byte),
+ *            first register (bits 4..0) | STREAM_RECORD_FILL (bit 7),
+ *            number of registers (1 to PCA9622_NUM_REGS),
+ *            register values, or a single value for STREAM_RECORD_FILL
+ *
+ * A record covers consecutive registers with Auto-Increment for all
+ * registers (AI_ALL). Frames only contain registers that changed since the
+ * previous frame, so the encoder emits the changed ranges of each device.
+ * The stream ends after the last frame
+ */
+#define PCA9622_STREAM_VERSION     1
+#define PCA9622_STREAM_HEADER_SIZE 5
+#define STREAM_RECORD_FILL         0x80 // All registers of the record get the same value
+
+#define PCA9622_STREAM_MIN_WINDOW  (3 + PCA9622_NUM_REGS) // Largest record
+
+// Player state, see PCA9622StreamPlayer::update()
+#define STREAM_PLAYING     0 // Frames left, or waiting for data
+#define STREAM_END         1 // All frames played
+#define STREAM_ERR_HEADER  2 // Not a frame stream, or unsupported version
+#define STREAM_ERR_FORMAT  3 // Invalid or truncated record
+#define STREAM_ERR_DEVICES 4 // Stream needs more devices than given
+
+/**
+ * Source of stream bytes, e.g. a file, a serial port or memory
+ */
+class PCA9622ByteSource {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Read the next bytes
+     *
+     * @param buffer Buffer for the bytes
+     * @param size   Size of buffer
+     *
+     * @return number of bytes read, 0 if none are available right now
+     */
+    virtual uint16_t read(uint8_t *buffer, uint16_t size) = 0;
+
+    /**
+     * @return true if no more bytes will ever be available
+     */
+    virtual bool atEnd() = 0;
+};
+
+/**
+ * Stream bytes from memory, e.g. a memory-mapped file on a host or a
+ * buffer in RAM
+ */
+class PCA9622MemorySource : public PCA9622ByteSource {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Constructor for PCA9622MemorySource
+     *
+     * @param data Stream bytes. Must stay valid while they are read
+     * @param size Number of bytes
+     */
+    PCA9622MemorySource(const uint8_t *data, uint32_t size);
+
+    uint16_t read(uint8_t *buffer, uint16_t size);
+    bool atEnd();
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+    const uint8_t *_data;
+    uint32_t _size;
+    uint32_t _position;
+};
+
+#if defined(ARDUINO)
+/**
+ * Stream bytes from an Arduino Stream, e.g. Serial or a File on an SD card
+ */
+class PCA9622StreamSource : public PCA9622ByteSource {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Constructor for PCA9622StreamSource
+     *
+     * @param stream     Stream to read from
+     * @param endAtEmpty true if the stream ended once nothing is available
+     *                   (files), false to wait for more data (serial ports)
+     */
+    PCA9622StreamSource(Stream &stream, bool endAtEmpty);
+
+    uint16_t read(uint8_t *buffer, uint16_t size);
+    bool atEnd();
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+    Stream &_stream;
+    bool _endAtEmpty;
+};
+#endif
+
+/**
+ * Plays a frame stream on a set of devices. Bytes are read into a small
+ * window, and register values are passed from the window straight to
+ * Auto-Increment transfers. Frames are played when their time has come;
+ * the delay between due time and the end of the frame's transfers is
+ * reported as drift
+ */
+class PCA9622StreamPlayer {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Constructor for PCA9622StreamPlayer
+     *
+     * @param devices    Array of initialized devices, indexed by the device
+     *                   index of the records. Must stay valid for the
+     *                   lifetime of the player
+     * @param numDevices Number of devices
+     * @param window     Buffer for stream bytes, at least
+     *                   PCA9622_STREAM_MIN_WINDOW bytes
+     * @param windowSize Size of window
+     */
+    PCA9622StreamPlayer(PCA9622 **devices, uint8_t numDevices, uint8_t *window, uint16_t windowSize);
+
+    /**
+     * Start playing a stream. The header must be available from the source
+     *
+     * @param source Source of the stream. Must stay valid while playing
+     * @param now    Current time in microseconds, e.g. micros(). Frame times
+     *               are relative to it
+     *
+     * @return STREAM_PLAYING or STREAM_ERR_*
+     */
+    uint8_t begin(PCA9622ByteSource *source, uint32_t now);
+
+    /**
+     * Play all frames that are due. Call this regularly from the main loop
+     *
+     * @param now Current time in microseconds, e.g. micros()
+     *
+     * @return STREAM_PLAYING, STREAM_END or STREAM_ERR_*
+     */
+    uint8_t update(uint32_t now);
+
+    /**
+     * @return frames played since begin()
+     */
+    uint32_t frames();
+
+    /**
+     * @return time the last frame was completed after it was due, in
+     *         microseconds
+     */
+    uint32_t lastDriftMicros();
+
+    /**
+     * @return largest drift since begin(), in microseconds
+     */
+    uint32_t maxDriftMicros();
+
+    /**
+     * @return calls to update() that found a due frame incomplete because
+     *         the source had no data yet
+     */
+    uint32_t underruns();
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+    /**
+     * Make bytes available in the window, refilling it from the source
+     *
+     * @param count Number of bytes needed
+     *
+     * @return number of bytes available, less than count if the source has
+     *         no more data right now
+     */
+    uint16_t fill(uint16_t count);
+
+    /**
+     * Read the time and record count of the next frame into _frameTime and
+     * _records
+     *
+     * @return STREAM_PLAYING if the frame header was read or is still
+     *         incomplete, STREAM_END or STREAM_ERR_*
+     */
+    uint8_t loadFrame();
+
+    /**
+     * Write the next record of the current frame
+     *
+     * @return STREAM_PLAYING if written or still incomplete, or STREAM_ERR_*
+     */
+    uint8_t playRecord();
+
+    PCA9622 **_devices;
+    uint8_t _numDevices;
+
+    uint8_t *_window;
+    uint16_t _windowSize;
+    uint16_t _position; // First unread byte in the window
+    uint16_t _length;   // Bytes in the window
+
+    PCA9622ByteSource *_source;
+    uint8_t _status;
+    bool _frameLoaded;
+    uint8_t _records;   // Records left in the current frame
+    uint32_t _start;
+    uint32_t _frameTime;
+
+    uint32_t _frames;
+    uint32_t _lastDrift;
+    uint32_t _maxDrift;
+    uint32_t _underruns;
+};
+#endif //PCA9622_STREAM_H
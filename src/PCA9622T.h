@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef PCA9622T_H
+#define PCA9622T_H
+
+#include "PCA9622.h"
+
+#define PCA9622_NO_CHANNEL 0xFF // Channel not present, e.g. white of an RGB fixture
+
+/**
+ * Compile-time mapping of PWM channels to colors for PCA9622T
+ *
+ * @tparam RegRedPwm     Register address for red color channel
+ * @tparam RegGreenPwm   Register address for green color channel
+ * @tparam RegBluePwm    Register address for blue color channel
+ * @tparam RegWhitePwm   Register address for white color channel, or
+ *                       PCA9622_NO_CHANNEL for RGB fixtures
+ * @tparam AutoIncrement Auto-Increment option for bursts (AI_IND, AI_IND_GBL
+ *                       or AI_ALL)
+ */
+template <uint8_t RegRedPwm, uint8_t RegGreenPwm, uint8_t RegBluePwm,
+          uint8_t RegWhitePwm = PCA9622_NO_CHANNEL, uint8_t AutoIncrement = AI_IND>
+struct PCA9622ChannelMap {
+    static constexpr uint8_t regRedPwm = RegRedPwm;
+    static constexpr uint8_t regGreenPwm = RegGreenPwm;
+    static constexpr uint8_t regBluePwm = RegBluePwm;
+    static constexpr uint8_t regWhitePwm = RegWhitePwm;
+    static constexpr bool hasWhiteChannel = (RegWhitePwm != PCA9622_NO_CHANNEL);
+    static constexpr uint8_t autoIncrement = AutoIncrement;
+};
+
+/**
+ * LEDOUT registers of one chip as last written through PCA9622T. All
+ * fixtures on the same chip share one instance, chips with the same address
+ * on different buses need one each
+ */
+struct PCA9622LedoutShadow {
+    uint8_t ledout[4]; // Filled by PCA9622T::begin()
+};
+
+/**
+ * PCA9622 fixture with device address and channel mapping fixed at compile
+ * time. Only the TwoWire pointer and the LEDOUT shadow of the chip are
+ * stored per instance. When the color channels are adjacent registers,
+ * setRGB() and setRGBW() are sent as a single Auto-Increment burst. There is
+ * no register cache apart from the LEDOUT registers shared per chip (see
+ * PCA9622LedoutShadow), so other read-modify-write operations are not
+ * offered; use PCA9622 for dynamic configurations
+ *
+ * @tparam DeviceAddress I2C address of the PCA9622
+ * @tparam ChannelMap    PCA9622ChannelMap of the fixture
+ */
+template <uint8_t DeviceAddress, class ChannelMap>
+class PCA9622T {
+
+    static_assert(ChannelMap::autoIncrement == AI_IND || ChannelMap::autoIncrement == AI_IND_GBL
+                  || ChannelMap::autoIncrement == AI_ALL,
+                  "Auto-Increment option must include the individual brightness registers");
+
+    static constexpr uint8_t min(uint8_t a, uint8_t b) {
+      return (a < b) ? a : b;
+    }
+
+    static constexpr uint8_t max(uint8_t a, uint8_t b) {
+      return (a > b) ? a : b;
+    }
+
+    // First and last register of the RGB channels
+    static constexpr uint8_t rgbFirst = min(min(ChannelMap::regRedPwm, ChannelMap::regGreenPwm), ChannelMap::regBluePwm);
+    static constexpr uint8_t rgbLast = max(max(ChannelMap::regRedPwm, ChannelMap::regGreenPwm), ChannelMap::regBluePwm);
+    static constexpr bool rgbAdjacent = (rgbLast - rgbFirst == 2);
+
+    // First and last register of the RGBW channels
+    static constexpr uint8_t rgbwFirst = ChannelMap::hasWhiteChannel ? min(rgbFirst, ChannelMap::regWhitePwm) : rgbFirst;
+    static constexpr uint8_t rgbwLast = ChannelMap::hasWhiteChannel ? max(rgbLast, ChannelMap::regWhitePwm) : rgbLast;
+    static constexpr bool rgbwAdjacent = (rgbwLast - rgbwFirst == 3);
+
+    // LDR bits of a channel within its LEDOUT register
+    static constexpr uint8_t ldrMask(uint8_t regPwm, uint8_t regLedout) {
+      return (regPwm != PCA9622_NO_CHANNEL && REG_LEDOUT0 + (regPwm - REG_PWM0) / 4 == regLedout)
+             ? 0b11 << (2 * ((regPwm - REG_PWM0) % 4)) : 0;
+    }
+
+    // LDR bits of all channels of the fixture within a LEDOUT register
+    static constexpr uint8_t ledoutMask(uint8_t regLedout) {
+      return ldrMask(ChannelMap::regRedPwm, regLedout) | ldrMask(ChannelMap::regGreenPwm, regLedout)
+           | ldrMask(ChannelMap::regBluePwm, regLedout) | ldrMask(ChannelMap::regWhitePwm, regLedout);
+    }
+
+    static constexpr uint8_t ledoutFirst = REG_LEDOUT0 + (rgbwFirst - REG_PWM0) / 4;
+    static constexpr uint8_t ledoutLast = REG_LEDOUT0 + (rgbwLast - REG_PWM0) / 4;
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Initialization of PCA9622
+     * Clear Mode register 1 and 2, and load the LEDOUT registers of the chip
+     * into the shadow shared with the other fixtures on it
+     *
+     * @param wire   Reference to TwoWire for I2C communication
+     * @param shadow LEDOUT shadow of the chip, shared by all fixtures on it.
+     *               Must stay valid for the lifetime of the fixture
+     *
+     * @return PCA9622_OK or PCA9622_ERR_* of reading the LEDOUT registers.
+     *         On failure the shadow is set to the power-up default
+     */
+    uint8_t begin(TwoWire *wire, PCA9622LedoutShadow *shadow) {
+
+      uint8_t *ledout = shadow->ledout;
+
+      _wire = wire;
+      _shadow = shadow;
+      _wire->begin();
+
+      writeReg(REG_MODE1, 0x0);
+      writeReg(REG_MODE2, 0x0);
+
+      _wire->beginTransmission(DeviceAddress);
+      _wire->write((AI_ALL << BIT_CTRL_AI) | REG_LEDOUT0);
+
+      uint8_t status = _wire->endTransmission(false);
+
+      if (status == PCA9622_OK && _wire->requestFrom(DeviceAddress, (uint8_t) 4) != 4) {
+        status = PCA9622_ERR_READ;
+      }
+
+      for (uint8_t i = 0; i < 4; i++) {
+        ledout[i] = (status == PCA9622_OK) ? _wire->read() : LDR_STATE_OFF;
+      }
+
+      return status;
+    }
+
+    /**
+     * Set individual PWM value for a given channel
+     *
+     * @param regPwm Register address for PWM channel
+     * @param pwm    PWM value
+     */
+    void setPwm(uint8_t regPwm, uint8_t pwm) {
+
+      writeReg(regPwm, pwm);
+    }
+
+    /**
+     * Set global PWM value for all channels
+     *
+     * @param pwm PWM value
+     */
+    void setGrpPwm(uint8_t pwm) {
+
+      writeReg(REG_GRPPWM, pwm);
+    }
+
+    /**
+    * Set PWM values for RGB
+    *
+    * @param r Value for red color channel
+    * @param g Value for green color channel
+    * @param b Value for blue color channel
+    */
+    void setRGB(uint8_t r, uint8_t g, uint8_t b) {
+
+      if (rgbAdjacent) {
+        uint8_t data[3];
+
+        data[ChannelMap::regRedPwm - rgbFirst] = r;
+        data[ChannelMap::regGreenPwm - rgbFirst] = g;
+        data[ChannelMap::regBluePwm - rgbFirst] = b;
+
+        writeRegs(ChannelMap::autoIncrement, rgbFirst, data, 3);
+      }
+      else {
+        writeReg(ChannelMap::regRedPwm, r);
+        writeReg(ChannelMap::regGreenPwm, g);
+        writeReg(ChannelMap::regBluePwm, b);
+      }
+    }
+
+    /**
+    * Set PWM values for RGBW. The white value is ignored for RGB fixtures
+    *
+    * @param r Value for red color channel
+    * @param g Value for green color channel
+    * @param b Value for blue color channel
+    * @param w Value for white color channel
+    */
+    void setRGBW(uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
+
+      if (!ChannelMap::hasWhiteChannel) {
+        setRGB(r, g, b);
+      }
+      else if (rgbwAdjacent) {
+        uint8_t data[4];
+
+        data[ChannelMap::regRedPwm - rgbwFirst] = r;
+        data[ChannelMap::regGreenPwm - rgbwFirst] = g;
+        data[ChannelMap::regBluePwm - rgbwFirst] = b;
+        data[ChannelMap::regWhitePwm - rgbwFirst] = w;
+
+        writeRegs(ChannelMap::autoIncrement, rgbwFirst, data, 4);
+      }
+      else {
+        setRGB(r, g, b);
+        writeReg(ChannelMap::regWhitePwm, w);
+      }
+    }
+
+    /**
+    * Set the LED driver output state for the channels of this fixture. The
+    * LEDOUT registers holding these channels are written in one burst, other
+    * channels in these registers keep their state from the shared shadow
+    *
+    * @param state One of the four possible states (see LDR_STATE_*)
+    */
+    void setLdrState(uint8_t state) {
+
+      uint8_t *shadow = _shadow->ledout;
+      uint8_t data[4];
+      uint8_t all = state * 0x55; // state in every LDR bit pair
+
+      for (uint8_t reg = ledoutFirst; reg <= ledoutLast; reg++) {
+        uint8_t i = reg - REG_LEDOUT0;
+
+        shadow[i] = (shadow[i] & ~ledoutMask(reg)) | (all & ledoutMask(reg));
+        data[reg - ledoutFirst] = shadow[i];
+      }
+
+      writeRegs(AI_ALL, ledoutFirst, data, ledoutLast - ledoutFirst + 1);
+    }
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+    /**
+    * Write data to a register
+    *
+    * @param registerAddress Register address to write to
+    * @param data            Data to write
+    */
+    void writeReg(uint8_t registerAddress, uint8_t data) {
+
+      writeRegs(AI_DISABLED, registerAddress, &data, 1);
+    }
+
+    /**
+    * Write data to consecutive registers in one transfer
+    *
+    * @param option          Auto-Increment option for this transfer (see AI_*)
+    * @param registerAddress First register address to write to
+    * @param data            Data to write
+    * @param count           Number of bytes to write
+    */
+    void writeRegs(uint8_t option, uint8_t registerAddress, const uint8_t *data, uint8_t count) {
+
+      _wire->beginTransmission(DeviceAddress);
+      _wire->write((option << BIT_CTRL_AI) | (registerAddress & MASK_CTRL_REG));
+      _wire->write(data, count);
+      _wire->endTransmission();
+    }
+
+    /**
+     * Object for I2C communication
+     */
+    TwoWire *_wire;
+
+    /**
+     * LEDOUT registers of the chip, shared with the other fixtures on it
+     */
+    PCA9622LedoutShadow *_shadow;
+};
+#endif //PCA9622T_H
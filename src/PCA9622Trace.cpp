@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#include "PCA9622Trace.h"
+
+#if defined(PCA9622_TRACE)
+
+static_assert((PCA9622_TRACE_SIZE & (PCA9622_TRACE_SIZE - 1)) == 0, "PCA9622_TRACE_SIZE must be a power of two");
+
+PCA9622TraceEntry PCA9622Trace::_entries[PCA9622_TRACE_SIZE];
+PCA9622Trace::Counter PCA9622Trace::_sequence[PCA9622_TRACE_SIZE];
+PCA9622Trace::Counter PCA9622Trace::_written(0);
+
+/******************************* PUBLIC METHODS *******************************/
+
+
+    /**
+     * Record a transfer that just ended
+     *
+     * @param start   Start of the transfer, micros()
+     * @param address 7-bit device address, TRACE_READ for reads
+     * @param control Control byte: Auto-Increment option and register address
+     * @param value   First data byte, 0 if none
+     * @param count   Number of data bytes
+     * @param status  PCA9622_OK or PCA9622_ERR_*
+     */
+void PCA9622Trace::record(uint32_t start, uint8_t address, uint8_t control, uint8_t value, uint8_t count, uint8_t status) {
+
+  uint32_t duration = micros() - start;
+
+#if defined(ARDUINO)
+  noInterrupts();
+  uint32_t index = _written++;
+  interrupts();
+#else
+  uint32_t index = _written.fetch_add(1);
+#endif
+
+  uint16_t slot = index & (PCA9622_TRACE_SIZE - 1);
+  PCA9622TraceEntry &entry = _entries[slot];
+
+  // Readers reject the slot until the entry is complete
+  _sequence[slot] = 0;
+
+  entry.micros = start;
+  entry.duration = duration > 0xFFFF ? 0xFFFF : duration;
+  entry.address = address;
+  entry.control = control;
+  entry.value = value;
+  entry.count = count;
+  entry.status = status;
+
+#if !defined(ARDUINO)
+  std::atomic_thread_fence(std::memory_order_release);
+#endif
+  _sequence[slot] = index + 1;
+}
+
+    /**
+     * @return transfers recorded since clear(). The entries still in the
+     *         buffer have the indexes from written() - PCA9622_TRACE_SIZE
+     *         (or 0) up to written() - 1
+     */
+uint32_t PCA9622Trace::written() {
+
+  return load(_written);
+}
+
+    /**
+     * Read an entry
+     *
+     * @param index Index of the entry, see written()
+     * @param entry Entry read
+     *
+     * @return false if the entry was overwritten or not recorded yet
+     */
+bool PCA9622Trace::read(uint32_t index, PCA9622TraceEntry &entry) {
+
+  uint16_t slot = index & (PCA9622_TRACE_SIZE - 1);
+
+  if (load(_sequence[slot]) != index + 1) {
+    return false;
+  }
+
+  entry = _entries[slot];
+
+  // Still valid if the slot was not reused while copying
+#if !defined(ARDUINO)
+  std::atomic_thread_fence(std::memory_order_acquire);
+#endif
+  return load(_sequence[slot]) == index + 1;
+}
+
+    /**
+     * Remove all entries
+     */
+void PCA9622Trace::clear() {
+
+  for (uint16_t slot = 0; slot < PCA9622_TRACE_SIZE; slot++) {
+    _sequence[slot] = 0;
+  }
+  _written = 0;
+}
+
+#if defined(ARDUINO)
+    /**
+     * Print all entries in the buffer in the dump format, e.g. to Serial
+     *
+     * @param out Output
+     */
+void PCA9622Trace::dump(Print &out) {
+
+  uint32_t end = load(_written);
+  uint32_t first = end > PCA9622_TRACE_SIZE ? end - PCA9622_TRACE_SIZE : 0;
+  PCA9622TraceEntry entry;
+
+  out.print(F("# PCA9622 trace, "));
+  out.print(end - first);
+  out.print(F(" entries, "));
+  out.print(first);
+  out.println(F(" dropped"));
+
+  for (uint32_t i = first; i < end; i++) {
+    if (!read(i, entry)) {
+      continue;
+    }
+
+    out.print(entry.micros);
+    out.print(',');
+    out.print(entry.address & ~TRACE_READ, HEX);
+    out.print(entry.address & TRACE_READ ? F(",r,") : F(",w,"));
+    out.print(entry.control, HEX);
+    out.print(',');
+    out.print(entry.count);
+    out.print(',');
+    out.print(entry.value, HEX);
+    out.print(',');
+    out.print(entry.status);
+    out.print(',');
+    out.println(entry.duration);
+  }
+}
+#else
+    /**
+     * Print all entries in the buffer in the dump format
+     *
+     * @param out Output
+     */
+void PCA9622Trace::dump(FILE *out) {
+
+  uint32_t end = load(_written);
+  uint32_t first = end > PCA9622_TRACE_SIZE ? end - PCA9622_TRACE_SIZE : 0;
+  PCA9622TraceEntry entry;
+
+  fprintf(out, "# PCA9622 trace, %lu entries, %lu dropped\n", (unsigned long)(end - first), (unsigned long)first);
+
+  for (uint32_t i = first; i < end; i++) {
+    if (!read(i, entry)) {
+      continue;
+    }
+
+    fprintf(out, "%lu,%X,%c,%X,%u,%X,%u,%u\n", (unsigned long)entry.micros, entry.address & ~TRACE_READ,
+            entry.address & TRACE_READ ? 'r' : 'w', entry.control, entry.count, entry.value, entry.status, entry.duration);
+  }
+}
+#endif
+
+/****************************** PRIVATE METHODS *******************************/
+
+
+    /**
+     * Read a counter in one piece, also where 32-bit reads are not atomic
+     *
+     * @param counter Counter to read
+     *
+     * @return value of the counter
+     */
+uint32_t PCA9622Trace::load(const Counter &counter) {
+
+#if defined(ARDUINO)
+  noInterrupts();
+  uint32_t value = counter;
+  interrupts();
+
+  return value;
+#else
+  return counter.load();
+#endif
+}
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef PCA9622_TRACE_H
+#define PCA9622_TRACE_H
+
+#include <Arduino.h>
+
+#if !defined(ARDUINO)
+  #include <stdio.h>
+  #include <atomic>
+#endif
+
+// Trace of the register traffic of all devices, for diagnosis in the field.
+// Only built with PCA9622_TRACE defined for the whole library, e.g.
+// build_flags = -DPCA9622_TRACE. Without it the hooks are empty and the
+// driver compiles to the same code as without tracing
+//
+// Dump format, one transfer per line (address, control and value in hex):
+//
+//   # PCA9622 trace, <entries> entries, <dropped> dropped
+//   <micros>,<address>,<r|w>,<control>,<count>,<value>,<status>,<duration>
+
+#ifndef PCA9622_TRACE_SIZE
+  #define PCA9622_TRACE_SIZE 32 // Entries in the ring buffer, a power of two
+#endif
+
+#define TRACE_READ 0x80 // Set in the address of read transfers
+
+/**
+ * One transfer on the bus. Retries are separate transfers
+ */
+struct PCA9622TraceEntry {
+    uint32_t micros;   // Start of the transfer
+    uint16_t duration; // Duration in microseconds, at most 0xFFFF
+    uint8_t address;   // 7-bit device address, TRACE_READ for reads
+    uint8_t control;   // Control byte: Auto-Increment option and register address
+    uint8_t value;     // First data byte, 0 if none
+    uint8_t count;     // Number of data bytes
+    uint8_t status;    // PCA9622_OK or PCA9622_ERR_*
+};
+
+#if defined(PCA9622_TRACE)
+  #define PCA9622_TRACE_TRANSFER(start, address, control, value, count, status) \
+    PCA9622Trace::record(start, address, control, value, count, status)
+#else
+  #define PCA9622_TRACE_TRANSFER(start, address, control, value, count, status)
+#endif
+
+/**
+ * Ring buffer of the last PCA9622_TRACE_SIZE transfers. Recording never
+ * blocks: a writer claims the next slot atomically (std::atomic on a host,
+ * interrupts masked on a microcontroller) and the oldest entries are
+ * overwritten. Each slot carries a sequence number, so a reader detects
+ * entries that were incomplete or overwritten while it read them
+ */
+class PCA9622Trace {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Record a transfer that just ended
+     *
+     * @param start   Start of the transfer, micros()
+     * @param address 7-bit device address, TRACE_READ for reads
+     * @param control Control byte: Auto-Increment option and register address
+     * @param value   First data byte, 0 if none
+     * @param count   Number of data bytes
+     * @param status  PCA9622_OK or PCA9622_ERR_*
+     */
+    static void record(uint32_t start, uint8_t address, uint8_t control, uint8_t value, uint8_t count, uint8_t status);
+
+    /**
+     * @return transfers recorded since clear(). The entries still in the
+     *         buffer have the indexes from written() - PCA9622_TRACE_SIZE
+     *         (or 0) up to written() - 1
+     */
+    static uint32_t written();
+
+    /**
+     * Read an entry
+     *
+     * @param index Index of the entry, see written()
+     * @param entry Entry read
+     *
+     * @return false if the entry was overwritten or not recorded yet
+     */
+    static bool read(uint32_t index, PCA9622TraceEntry &entry);
+
+    /**
+     * Remove all entries
+     */
+    static void clear();
+
+#if defined(ARDUINO)
+    /**
+     * Print all entries in the buffer in the dump format, e.g. to Serial
+     *
+     * @param out Output
+     */
+    static void dump(Print &out);
+#else
+    /**
+     * Print all entries in the buffer in the dump format
+     *
+     * @param out Output
+     */
+    static void dump(FILE *out);
+#endif
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+#if defined(ARDUINO)
+    typedef volatile uint32_t Counter;
+#else
+    typedef std::atomic<uint32_t> Counter;
+#endif
+
+    /**
+     * Read a counter in one piece, also where 32-bit reads are not atomic
+     *
+     * @param counter Counter to read
+     *
+     * @return value of the counter
+     */
+    static uint32_t load(const Counter &counter);
+
+    static PCA9622TraceEntry _entries[PCA9622_TRACE_SIZE];
+
+    /**
+     * Per slot: index + 1 of the entry it holds once complete, 0 while it is
+     * written
+     */
+    static Counter _sequence[PCA9622_TRACE_SIZE];
+
+    /**
+     * Count of claimed entries. Incremented before an entry is written
+     */
+    static Counter _written;
+};
+#endif //PCA9622_TRACE_H
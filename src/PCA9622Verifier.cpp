@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#include "PCA9622Verifier.h"
+
+/******************************* PUBLIC METHODS *******************************/
+
+
+    /**
+     * Constructor for PCA9622Verifier
+     *
+     * @param device Device to verify. Must stay valid for the lifetime of
+     *               the verifier
+     * @param window Registers per read, 1 to PCA9622_NUM_REGS. Larger windows
+     *               have less overhead per register, smaller ones spread the
+     *               bus time more evenly
+     */
+PCA9622Verifier::PCA9622Verifier(PCA9622 *device, uint8_t window) {
+
+  _device = device;
+  _window = (window == 0) ? 1 : (window > PCA9622_NUM_REGS) ? PCA9622_NUM_REGS : window;
+
+  begin(0, 0);
+}
+
+    /**
+     * Start verifying and clear the statistics
+     *
+     * @param budgetPermille Share of the bus time for reads and repairs, in
+     *                       per mille (10 = 1%)
+     * @param now            Current time in microseconds, e.g. micros()
+     */
+void PCA9622Verifier::begin(uint16_t budgetPermille, uint32_t now) {
+
+  _nextReg = REG_MODE1;
+
+  _budgetPermille = budgetPermille;
+  _credit = 0;
+  _lastUpdate = now;
+
+  _cycleRegs = 0;
+  _cycleRepairs = 0;
+  _cycleStart = now;
+  _cycleMicros = 0;
+
+  _begin = now;
+  _busMicros = 0;
+  _detections = 0;
+  _mismatches = 0;
+  _failedRepairs = 0;
+  _lastDetection = 0;
+}
+
+    /**
+     * Read and verify the next window if the budget allows it. Dirty
+     * registers, staged in deferred mode or waiting for a retry, are not
+     * compared. Call this regularly from the main loop
+     *
+     * @param now Current time in microseconds, e.g. micros()
+     *
+     * @return true if a window was read
+     */
+bool PCA9622Verifier::update(uint32_t now) {
+
+  uint32_t elapsed = now - _lastUpdate;
+
+  _lastUpdate = now;
+
+  // Split to avoid an overflow. Unused credit is not saved up, so reads don't bunch up
+  _credit += (elapsed / 1000) * _budgetPermille + (elapsed % 1000) * _budgetPermille / 1000;
+
+  if (_credit > 0) {
+    _credit = 0;
+  }
+
+  if (_credit < 0 || _budgetPermille == 0) {
+    return false;
+  }
+
+  uint8_t data[PCA9622_NUM_REGS];
+  uint32_t start = micros();
+
+  if (_device->readRegs(_nextReg, data, _window) == PCA9622_OK) {
+    uint8_t reg = _nextReg;
+    uint32_t differ = 0;
+    uint32_t dirty = _device->_dirtyRegs;
+
+    for (uint8_t i = 0; i < _window; i++) {
+      uint8_t mask = (reg == REG_MODE1) ? ~MASK_MODE1_AI : 0xFF;
+
+      // Dirty registers, staged or waiting for a retry, are not on the chip yet
+      if (!(dirty & (1UL << reg)) && ((data[i] ^ _device->_reg[reg]) & mask)) {
+        differ |= (1UL << reg);
+        _mismatches++;
+
+        // Track the SLEEP state actually on the chip, so waking it up waits for the oscillator
+        if (reg == REG_MODE1) {
+          _device->_chipAsleep = data[i] & (1 << BIT_SLEEP);
+        }
+      }
+      reg = (reg + 1) % PCA9622_NUM_REGS;
+    }
+
+    if (differ != 0) {
+      _detections++;
+      _lastDetection = micros();
+
+      // Bounded, so a chip that keeps losing its registers can't take the bus
+      if (_cycleRepairs < PCA9622_VERIFY_MAX_REPAIRS) {
+        _cycleRepairs++;
+
+        _device->_dirtyRegs = differ;
+        _device->flushDirty();
+
+        // A failed repair marks the device for checkHealth() and is not retried
+        if (_device->_dirtyRegs != 0) {
+          _failedRepairs++;
+        }
+        _device->_dirtyRegs = dirty;
+      }
+    }
+
+    _nextReg = reg;
+    _cycleRegs += _window;
+
+    if (_cycleRegs >= PCA9622_NUM_REGS) {
+      _cycleRegs -= PCA9622_NUM_REGS;
+      _cycleRepairs = 0;
+      _cycleMicros = now - _cycleStart;
+      _cycleStart = now;
+    }
+  }
+
+  uint32_t used = micros() - start;
+
+  _credit -= used;
+  _busMicros += used;
+
+  return true;
+}
+
+    /**
+     * @return windows in which registers differed from the register cache
+     */
+uint32_t PCA9622Verifier::detections() {
+
+  return _detections;
+}
+
+    /**
+     * @return registers that differed from the register cache
+     */
+uint32_t PCA9622Verifier::mismatches() {
+
+  return _mismatches;
+}
+
+    /**
+     * @return repairs that could not be written since begin()
+     */
+uint32_t PCA9622Verifier::failedRepairs() {
+
+  return _failedRepairs;
+}
+
+    /**
+     * @return time of the last detection, micros()
+     */
+uint32_t PCA9622Verifier::lastDetectionMicros() {
+
+  return _lastDetection;
+}
+
+    /**
+     * @return duration of the last complete rotation through all registers
+     *         in microseconds, the longest time until a change is detected.
+     *         0 before the first rotation is complete
+     */
+uint32_t PCA9622Verifier::cycleMicros() {
+
+  return _cycleMicros;
+}
+
+    /**
+     * @return bus time of reads and repairs since begin() in microseconds
+     */
+uint32_t PCA9622Verifier::busMicros() {
+
+  return _busMicros;
+}
+
+    /**
+     * Share of the bus time used since begin()
+     *
+     * @param now Current time in microseconds, e.g. micros()
+     *
+     * @return share in per mille
+     */
+uint16_t PCA9622Verifier::busPermille(uint32_t now) {
+
+  uint32_t elapsed = now - _begin;
+
+  if (elapsed == 0) {
+    return 0;
+  }
+
+  return (uint64_t) _busMicros * 1000 / elapsed;
+}
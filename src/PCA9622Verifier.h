@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef PCA9622_VERIFIER_H
+#define PCA9622_VERIFIER_H
+
+#include "PCA9622.h"
+
+#define PCA9622_VERIFY_WINDOW      7 // Default registers per read, 4 reads cover all registers
+#define PCA9622_VERIFY_MAX_REPAIRS 2 // Repair transfers per rotation, further mismatches wait for the next one
+
+/**
+ * Verifies in the background that a PCA9622 holds the registers the driver
+ * wrote, e.g. after a brown-out. Each update() reads a window of registers
+ * in one burst, rotating through all registers, and compares it with the
+ * register cache. Registers that differ are written again, nearby ones in
+ * the same transfer, up to PCA9622_VERIFY_MAX_REPAIRS times per rotation.
+ * A repair that fails is counted and left to PCA9622::checkHealth(). The
+ * reads are spread out so that the verifier takes at most a given share of
+ * the bus time.
+ *
+ * A change on the chip is detected at the latest one rotation after it
+ * happened, see cycleMicros()
+ */
+class PCA9622Verifier {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Constructor for PCA9622Verifier
+     *
+     * @param device Device to verify. Must stay valid for the lifetime of
+     *               the verifier
+     * @param window Registers per read, 1 to PCA9622_NUM_REGS. Larger windows
+     *               have less overhead per register, smaller ones spread the
+     *               bus time more evenly
+     */
+    PCA9622Verifier(PCA9622 *device, uint8_t window = PCA9622_VERIFY_WINDOW);
+
+    /**
+     * Start verifying and clear the statistics
+     *
+     * @param budgetPermille Share of the bus time for reads and repairs, in
+     *                       per mille (10 = 1%)
+     * @param now            Current time in microseconds, e.g. micros()
+     */
+    void begin(uint16_t budgetPermille, uint32_t now);
+
+    /**
+     * Read and verify the next window if the budget allows it. Dirty
+     * registers, staged in deferred mode or waiting for a retry, are not
+     * compared. Call this regularly from the main loop
+     *
+     * @param now Current time in microseconds, e.g. micros()
+     *
+     * @return true if a window was read
+     */
+    bool update(uint32_t now);
+
+    /**
+     * @return windows in which registers differed from the register cache
+     */
+    uint32_t detections();
+
+    /**
+     * @return registers that differed from the register cache
+     */
+    uint32_t mismatches();
+
+    /**
+     * @return repairs that could not be written since begin()
+     */
+    uint32_t failedRepairs();
+
+    /**
+     * @return time of the last detection, micros()
+     */
+    uint32_t lastDetectionMicros();
+
+    /**
+     * @return duration of the last complete rotation through all registers
+     *         in microseconds, the longest time until a change is detected.
+     *         0 before the first rotation is complete
+     */
+    uint32_t cycleMicros();
+
+    /**
+     * @return bus time of reads and repairs since begin() in microseconds
+     */
+    uint32_t busMicros();
+
+    /**
+     * Share of the bus time used since begin()
+     *
+     * @param now Current time in microseconds, e.g. micros()
+     *
+     * @return share in per mille
+     */
+    uint16_t busPermille(uint32_t now);
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+    PCA9622 *_device;
+    uint8_t _window;
+
+    /**
+     * First register of the next window
+     */
+    uint8_t _nextReg;
+
+    /**
+     * Budget: bus time earned at budgetPermille minus bus time used, in
+     * microseconds. A window is read when the previous ones are paid for
+     */
+    uint16_t _budgetPermille;
+    int32_t _credit;
+    uint32_t _lastUpdate;
+
+    /**
+     * Rotation through all registers
+     */
+    uint8_t _cycleRegs;
+    uint8_t _cycleRepairs;
+    uint32_t _cycleStart;
+    uint32_t _cycleMicros;
+
+    uint32_t _begin;
+    uint32_t _busMicros;
+    uint32_t _detections;
+    uint32_t _mismatches;
+    uint32_t _failedRepairs;
+    uint32_t _lastDetection;
+};
+#endif //PCA9622_VERIFIER_H
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#include "PCA9622View.h"
+
+/******************************* PUBLIC METHODS *******************************/
+
+
+    /**
+     * Constructor for PCA9622ChannelView
+     *
+     * @param device PCA9622 holding the register state
+     * @param regPwm Register address for PWM channel
+     */
+PCA9622ChannelView::PCA9622ChannelView(PCA9622 *device, uint8_t regPwm) {
+
+  _device = device;
+  _regPwm = regPwm;
+}
+
+    /**
+     * Stage the PWM value of the channel
+     *
+     * @param pwm PWM value
+     */
+void PCA9622ChannelView::setPwm(uint8_t pwm) {
+
+  stagePwm(_device, _regPwm, pwm);
+}
+
+    /**
+     * @return PWM value of the channel, from the register cache
+     */
+uint8_t PCA9622ChannelView::getPwm() {
+
+  return _device->getPwm(_regPwm);
+}
+
+    /**
+     * Stage the LED driver output state of the channel
+     *
+     * @param state One of the four possible states (see LDR_STATE_*)
+     */
+void PCA9622ChannelView::setLdrState(uint8_t state) {
+
+  stageLdrStates(_device, channelBit(_regPwm), state);
+}
+
+    /**
+     * Constructor for PCA9622RGBView
+     *
+     * @param device      PCA9622 holding the register state
+     * @param regRedPwm   Register address for red color channel
+     * @param regGreenPwm Register address for green color channel
+     * @param regBluePwm  Register address for blue color channel
+     */
+PCA9622RGBView::PCA9622RGBView(PCA9622 *device, uint8_t regRedPwm, uint8_t regGreenPwm, uint8_t regBluePwm) {
+
+  _device = device;
+  _regRedPwm = regRedPwm;
+  _regGreenPwm = regGreenPwm;
+  _regBluePwm = regBluePwm;
+}
+
+    /**
+     * Stage PWM values for RGB
+     *
+     * @param r Value for red color channel
+     * @param g Value for green color channel
+     * @param b Value for blue color channel
+     */
+void PCA9622RGBView::setRGB(uint8_t r, uint8_t g, uint8_t b) {
+
+  stagePwm(_device, _regRedPwm, r);
+  stagePwm(_device, _regGreenPwm, g);
+  stagePwm(_device, _regBluePwm, b);
+}
+
+    /**
+     * Stage the LED driver output state of all channels of the fixture
+     *
+     * @param state One of the four possible states (see LDR_STATE_*)
+     */
+void PCA9622RGBView::setLdrState(uint8_t state) {
+
+  stageLdrStates(_device, channelBit(_regRedPwm) | channelBit(_regGreenPwm) | channelBit(_regBluePwm), state);
+}
+
+    /**
+     * Constructor for PCA9622RGBWView
+     *
+     * @param device      PCA9622 holding the register state
+     * @param regRedPwm   Register address for red color channel
+     * @param regGreenPwm Register address for green color channel
+     * @param regBluePwm  Register address for blue color channel
+     * @param regWhitePwm Register address for white color channel
+     */
+PCA9622RGBWView::PCA9622RGBWView(PCA9622 *device, uint8_t regRedPwm, uint8_t regGreenPwm, uint8_t regBluePwm, uint8_t regWhitePwm) {
+
+  _device = device;
+  _regRedPwm = regRedPwm;
+  _regGreenPwm = regGreenPwm;
+  _regBluePwm = regBluePwm;
+  _regWhitePwm = regWhitePwm;
+}
+
+    /**
+     * Stage PWM values for RGBW
+     *
+     * @param r Value for red color channel
+     * @param g Value for green color channel
+     * @param b Value for blue color channel
+     * @param w Value for white color channel
+     */
+void PCA9622RGBWView::setRGBW(uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
+
+  stagePwm(_device, _regRedPwm, r);
+  stagePwm(_device, _regGreenPwm, g);
+  stagePwm(_device, _regBluePwm, b);
+  stagePwm(_device, _regWhitePwm, w);
+}
+
+    /**
+     * Stage the LED driver output state of all channels of the fixture
+     *
+     * @param state One of the four possible states (see LDR_STATE_*)
+     */
+void PCA9622RGBWView::setLdrState(uint8_t state) {
+
+  stageLdrStates(_device, channelBit(_regRedPwm) | channelBit(_regGreenPwm)
+                        | channelBit(_regBluePwm) | channelBit(_regWhitePwm), state);
+}
+
+/****************************** PRIVATE METHODS *******************************/
+
+
+    /**
+     * Stage a PWM value, corrected by the brightness table of the device
+     *
+     * @param device PCA9622 of the channel
+     * @param regPwm Register address for PWM channel
+     * @param pwm    PWM value
+     */
+void PCA9622View::stagePwm(PCA9622 *device, uint8_t regPwm, uint8_t pwm) {
+
+  device->stageReg(regPwm, device->correct(regPwm, pwm));
+}
+
+    /**
+     * Stage the LED driver output state of channels
+     *
+     * @param device      PCA9622 of the channels
+     * @param channelMask Bit n set for channel n (REG_PWM0 + n)
+     * @param state       One of the four possible states (see LDR_STATE_*)
+     */
+void PCA9622View::stageLdrStates(PCA9622 *device, uint16_t channelMask, uint8_t state) {
+
+  for (uint8_t i = 0; i < 4; i++) {
+    uint8_t reg = device->_reg[REG_LEDOUT0 + i];
+
+    for (uint8_t ldr = 0; ldr < 4; ldr++) {
+      if (channelMask & (1 << (4 * i + ldr))) {
+        reg &= ~(0b11 << (2 * ldr));
+        reg |= (state << (2 * ldr));
+      }
+    }
+
+    device->stageReg(REG_LEDOUT0 + i, reg);
+  }
+}
+
+    /**
+     * @return bit of a channel for a channel mask
+     */
+uint16_t PCA9622View::channelBit(uint8_t regPwm) {
+
+  return (regPwm >= REG_PWM0 && regPwm <= REG_PWM15) ? 1 << (regPwm - REG_PWM0) : 0;
+}
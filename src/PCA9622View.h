@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2021 Daniel Guedel
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+#ifndef PCA9622_VIEW_H
+#define PCA9622_VIEW_H
+
+#include "PCA9622.h"
+
+/**
+ * Base of the fixture views. A view references a subset of the channels of
+ * a PCA9622 that holds the register state for all fixtures on the chip.
+ * Setters of a view only stage changes in the register cache of the
+ * device; PCA9622::commit() then sends the changes of all views on the chip
+ * in a single burst. A view only stores the device pointer and its register
+ * addresses
+ */
+class PCA9622View {
+
+/****************************** PRIVATE METHODS *******************************/
+protected:
+
+    /**
+     * Stage a PWM value, corrected by the brightness table of the device
+     *
+     * @param device PCA9622 of the channel
+     * @param regPwm Register address for PWM channel
+     * @param pwm    PWM value
+     */
+    static void stagePwm(PCA9622 *device, uint8_t regPwm, uint8_t pwm);
+
+    /**
+     * Stage the LED driver output state of channels
+     *
+     * @param device      PCA9622 of the channels
+     * @param channelMask Bit n set for channel n (REG_PWM0 + n)
+     * @param state       One of the four possible states (see LDR_STATE_*)
+     */
+    static void stageLdrStates(PCA9622 *device, uint16_t channelMask, uint8_t state);
+
+    /**
+     * @return bit of a channel for a channel mask
+     */
+    static uint16_t channelBit(uint8_t regPwm);
+};
+
+/**
+ * View of a single channel of a shared PCA9622
+ */
+class PCA9622ChannelView : public PCA9622View {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Constructor for PCA9622ChannelView
+     *
+     * @param device PCA9622 holding the register state
+     * @param regPwm Register address for PWM channel
+     */
+    PCA9622ChannelView(PCA9622 *device, uint8_t regPwm);
+
+    /**
+     * Stage the PWM value of the channel
+     *
+     * @param pwm PWM value
+     */
+    void setPwm(uint8_t pwm);
+
+    /**
+     * @return PWM value of the channel, from the register cache
+     */
+    uint8_t getPwm();
+
+    /**
+     * Stage the LED driver output state of the channel
+     *
+     * @param state One of the four possible states (see LDR_STATE_*)
+     */
+    void setLdrState(uint8_t state);
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+    PCA9622 *_device;
+    uint8_t _regPwm;
+};
+
+/**
+ * View of an RGB fixture on a shared PCA9622
+ */
+class PCA9622RGBView : public PCA9622View {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Constructor for PCA9622RGBView
+     *
+     * @param device      PCA9622 holding the register state
+     * @param regRedPwm   Register address for red color channel
+     * @param regGreenPwm Register address for green color channel
+     * @param regBluePwm  Register address for blue color channel
+     */
+    PCA9622RGBView(PCA9622 *device, uint8_t regRedPwm, uint8_t regGreenPwm, uint8_t regBluePwm);
+
+    /**
+     * Stage PWM values for RGB
+     *
+     * @param r Value for red color channel
+     * @param g Value for green color channel
+     * @param b Value for blue color channel
+     */
+    void setRGB(uint8_t r, uint8_t g, uint8_t b);
+
+    /**
+     * Stage the LED driver output state of all channels of the fixture
+     *
+     * @param state One of the four possible states (see LDR_STATE_*)
+     */
+    void setLdrState(uint8_t state);
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+    PCA9622 *_device;
+    uint8_t _regRedPwm, _regGreenPwm, _regBluePwm;
+};
+
+/**
+ * View of an RGBW fixture on a shared PCA9622
+ */
+class PCA9622RGBWView : public PCA9622View {
+
+/******************************* PUBLIC METHODS *******************************/
+public:
+
+    /**
+     * Constructor for PCA9622RGBWView
+     *
+     * @param device      PCA9622 holding the register state
+     * @param regRedPwm   Register address for red color channel
+     * @param regGreenPwm Register address for green color channel
+     * @param regBluePwm  Register address for blue color channel
+     * @param regWhitePwm Register address for white color channel
+     */
+    PCA9622RGBWView(PCA9622 *device, uint8_t regRedPwm, uint8_t regGreenPwm, uint8_t regBluePwm, uint8_t regWhitePwm);
+
+    /**
+     * Stage PWM values for RGBW
+     *
+     * @param r Value for red color channel
+     * @param g Value for green color channel
+     * @param b Value for blue color channel
+     * @param w Value for white color channel
+     */
+    void setRGBW(uint8_t r, uint8_t g, uint8_t b, uint8_t w);
+
+    /**
+     * Stage the LED driver output state of all channels of the fixture
+     *
+     * @param state One of the four possible states (see LDR_STATE_*)
+     */
+    void setLdrState(uint8_t state);
+
+/****************************** PRIVATE METHODS *******************************/
+private:
+
+    PCA9622 *_device;
+    uint8_t _regRedPwm, _regGreenPwm, _regBluePwm, _regWhitePwm;
+};
+#endif //PCA9622_VIEW_H